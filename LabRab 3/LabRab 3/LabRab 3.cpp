@@ -1,211 +1,311 @@
 ﻿#include <iostream>
 #include <vector>
-#include <stdexcept>
-#include <iomanip> // Для работы с форматированием вывода
+#include <string>
+#include <chrono>
+#include "array3d.hpp"
+#include "chunked.hpp"
+#include "stencil.hpp"
+#include "sparse.hpp"
 
 using namespace std;
 
-class Array3d {
-private:
-    int dim0, dim1, dim2;  // Размеры массива
-    vector<double> data;   // Одномерный контейнер для хранения элементов
+// Замер времени выполнения действия в миллисекундах
+template <typename F>
+double measureMs(F action) {
+    auto start = chrono::steady_clock::now();
+    action();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
-    // Функция для перевода трехмерных индексов в одномерный
-    int getIndex(int i, int j, int k) const {
-        if (i < 0 || i >= dim0 || j < 0 || j >= dim1 || k < 0 || k >= dim2) {
-            throw out_of_range("Индексы выходят за пределы массива");
-        }
-        return i * dim1 * dim2 + j * dim2 + k;  // Математика для одномерного массива
-    }
+// Замер чтения срезов всех направлений для заданного размещения
+template <typename Layout>
+void benchSlices(int n) {
+    BasicArray3d<double, Layout> array(n, n, n);
+    array.fill(1.0);
+    double sink = 0; // чтобы компилятор не выбросил чтение
 
-public:
-    // Конструктор для создания массива заданных размеров
-    Array3d(int d0, int d1, int d2) : dim0(d0), dim1(d1), dim2(d2), data(d0* d1* d2) {}
+    cout << Layout::name << " (" << n << "^3):" << endl;
+    cout << "  GetValues0  " << measureMs([&] { for (int i = 0; i < n; ++i) sink += array.GetValues0(i)[0][0]; }) << " ms" << endl;
+    cout << "  GetValues1  " << measureMs([&] { for (int j = 0; j < n; ++j) sink += array.GetValues1(j)[0][0]; }) << " ms" << endl;
+    cout << "  GetValues2  " << measureMs([&] { for (int k = 0; k < n; ++k) sink += array.GetValues2(k)[0][0]; }) << " ms" << endl;
+    cout << "  GetValues01 " << measureMs([&] { for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) sink += array.GetValues01(i, j)[0][0]; }) << " ms" << endl;
+    cout << "  GetValues02 " << measureMs([&] { for (int i = 0; i < n; ++i) for (int k = 0; k < n; ++k) sink += array.GetValues02(i, k)[0][0]; }) << " ms" << endl;
+    cout << "  GetValues12 " << measureMs([&] { for (int j = 0; j < n; ++j) for (int k = 0; k < n; ++k) sink += array.GetValues12(j, k)[0][0]; }) << " ms" << endl;
+    if (sink < 0) cout << sink << endl;
+}
 
-    // Индексатор для доступа к элементам массива по трехмерным индексам
-    double& operator()(int i, int j, int k) {
-        return data[getIndex(i, j, k)];
-    }
+// Замер поэлементной арифметики и сверток (пропускная способность памяти)
+void benchArithmetic(size_t n) {
+    Array3d a(n, n, n), b(n, n, n), c(n, n, n);
+    a.fill(1.0);
+    b.fill(2.0);
+    double gb = double(a.size() * sizeof(double)) / 1e9;
 
-    const double& operator()(int i, int j, int k) const {
-        return data[getIndex(i, j, k)];
+    double ms = measureMs([&] { c = a + b * 2.0 - 1.0; }); // читаем 2 массива, пишем 1
+    cout << "c = a + b * 2 - 1  " << ms << " ms, " << 3 * gb / (ms / 1000) << " GB/s" << endl;
+    ms = measureMs([&] { axpy(0.5, a, c); });
+    cout << "axpy               " << ms << " ms, " << 3 * gb / (ms / 1000) << " GB/s" << endl;
+    double total = 0;
+    ms = measureMs([&] { total = c.sum(); });
+    cout << "sum()              " << ms << " ms, " << gb / (ms / 1000) << " GB/s" << endl;
+    for (int axis = 0; axis < 3; ++axis) {
+        ms = measureMs([&] { total += c.sum(axis).sum(); });
+        cout << "sum(" << axis << ")             " << ms << " ms" << endl;
     }
+    if (total < 0) cout << total << endl;
+}
 
-    // Получение среза по первой координате
-    vector<vector<double>> GetValues0(int i) const {
-        if (i < 0 || i >= dim0) {
-            throw out_of_range("Индекс i выходит за пределы массива");
-        }
-        vector<vector<double>> slice(dim1, vector<double>(dim2));
-        for (int j = 0; j < dim1; ++j) {
-            for (int k = 0; k < dim2; ++k) {
-                slice[j][k] = data[getIndex(i, j, k)];
+// Замер блочного формата: запись целиком и чтение срезов с ленивой распаковкой
+void benchChunked(size_t n) {
+    Array3d a(n, n, n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t k = 0; k < n; ++k) {
+                a.unchecked(i, j, k) = double(i + j) * 0.5; // гладкие данные, как у реальных объемов
             }
         }
-        return slice;
     }
+    double ms = measureMs([&] { saveChunked(a, "bench.a3c"); });
+    ifstream packed("bench.a3c", ios::binary | ios::ate);
+    cout << "saveChunked        " << ms << " ms, " << double(packed.tellg()) / 1e6 << " MB из "
+         << double(a.size() * sizeof(double)) / 1e6 << " MB" << endl;
 
-    // Получение среза по второй координате
-    vector<vector<double>> GetValues1(int j) const {
-        if (j < 0 || j >= dim1) {
-            throw out_of_range("Индекс j выходит за пределы массива");
-        }
-        vector<vector<double>> slice(dim0, vector<double>(dim2));
-        for (int i = 0; i < dim0; ++i) {
-            for (int k = 0; k < dim2; ++k) {
-                slice[i][k] = data[getIndex(i, j, k)];
-            }
-        }
-        return slice;
+    ChunkedArray3d<double> chunked("bench.a3c", 64);
+    double sink = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        ms = measureMs([&] {
+            auto slice = axis == 0 ? chunked.GetValues0(n / 2) : axis == 1 ? chunked.GetValues1(n / 2) : chunked.GetValues2(n / 2);
+            sink += slice[0][0];
+        });
+        cout << "chunked GetValues" << axis << " " << ms << " ms" << endl;
     }
+    if (sink < 0) cout << sink << endl;
+    remove("bench.a3c");
+}
 
-    // Получение среза по третьей координате
-    vector<vector<double>> GetValues2(int k) const {
-        if (k < 0 || k >= dim2) {
-            throw out_of_range("Индекс k выходит за пределы массива");
-        }
-        vector<vector<double>> slice(dim0, vector<double>(dim1));
-        for (int i = 0; i < dim0; ++i) {
-            for (int j = 0; j < dim1; ++j) {
-                slice[i][j] = data[getIndex(i, j, k)];
-            }
-        }
-        return slice;
-    }
+// Замер шаблонных вычислений в миллиардах ячеек в секунду
+void benchStencil(size_t n) {
+    Array3d a(n, n, n), b(n, n, n);
+    a.fill(1.0);
+    double cells = double(a.size());
+    auto report = [&](const char* name, double ms, double passes) {
+        cout << name << ms << " ms, " << cells * passes / (ms / 1000) / 1e9 << " Gcells/s" << endl;
+    };
 
-    // Получение среза по первой и второй координатам
-    vector<vector<double>> GetValues01(int i, int j) const {
-        if (i < 0 || i >= dim0 || j < 0 || j >= dim1) {
-            throw out_of_range("Индексы i или j выходят за пределы массива");
-        }
-        vector<double> slice(dim2);
-        for (int k = 0; k < dim2; ++k) {
-            slice[k] = data[getIndex(i, j, k)];
+    // для сравнения: наивный тройной цикл по внутренней области (без границ и потоков)
+    report("laplacian 7, naive ", measureMs([&] {
+        for (size_t i = 1; i + 1 < n; ++i) {
+            for (size_t j = 1; j + 1 < n; ++j) {
+                for (size_t k = 1; k + 1 < n; ++k) {
+                    b.unchecked(i, j, k) = a.unchecked(i - 1, j, k) + a.unchecked(i + 1, j, k) + a.unchecked(i, j - 1, k)
+                        + a.unchecked(i, j + 1, k) + a.unchecked(i, j, k - 1) + a.unchecked(i, j, k + 1) - 6.0 * a.unchecked(i, j, k);
+                }
+            }
         }
-        return { slice };
-    }
+    }), 1);
+    report("laplacian 7        ", measureMs([&] { applyStencil<Laplacian7>(a, b); }), 1);
+    report("laplacian 27       ", measureMs([&] { applyStencil<Laplacian27>(a, b); }), 1);
+    report("laplacian 7, wrap  ", measureMs([&] { applyStencil<Laplacian7, WrapBoundary>(a, b); }), 1);
+    report("heat, 10 steps     ", measureMs([&] { iterateStencil<Laplacian7>(a, 10, 0.1, 1.0); }), 10);
+    report("gaussian sigma=1   ", measureMs([&] { gaussianBlur(a, 1.0); }), 1);
+}
 
-    // Получение среза по первой и третьей координатам
-    vector<vector<double>> GetValues02(int i, int k) const {
-        if (i < 0 || i >= dim0 || k < 0 || k >= dim2) {
-            throw out_of_range("Индексы i или k выходят за пределы массива");
-        }
-        vector<double> slice(dim1);
-        for (int j = 0; j < dim1; ++j) {
-            slice[j] = data[getIndex(i, j, k)];
+// Замер перестановки осей: рекурсивная против наивного тройного цикла
+void benchPermute(size_t n) {
+    Array3d a(n, n, n);
+    a.fill(1.0);
+    double gb = 2 * double(a.size() * sizeof(double)) / 1e9;
+    double ms = measureMs([&] {
+        Array3d naive(n, n, n);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                for (size_t k = 0; k < n; ++k) {
+                    naive(k, i, j) = a(i, j, k);
+                }
+            }
         }
-        return { slice };
-    }
+    });
+    cout << "permute, naive     " << ms << " ms, " << gb / (ms / 1000) << " GB/s" << endl;
+    ms = measureMs([&] { Array3d b = a.permute({ 2, 0, 1 }); });
+    cout << "permute({2,0,1})   " << ms << " ms, " << gb / (ms / 1000) << " GB/s" << endl;
+    ms = measureMs([&] { a.permuteInPlace({ 2, 1, 0 }); });
+    cout << "permuteInPlace     " << ms << " ms, " << gb / (ms / 1000) << " GB/s" << endl;
+}
 
-    // Получение среза по второй и третьей координатам
-    vector<vector<double>> GetValues12(int j, int k) const {
-        if (j < 0 || j >= dim1 || k < 0 || k >= dim2) {
-            throw out_of_range("Индексы j или k выходят за пределы массива");
-        }
-        vector<double> slice(dim0);
-        for (int i = 0; i < dim0; ++i) {
-            slice[i] = data[getIndex(i, j, k)];
+// Разреженный массив: шар радиуса n/8 в пустом объеме
+void benchSparse(size_t n) {
+    Array3d dense(n, n, n);
+    double r = double(n) / 8, c = double(n) / 2;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t k = 0; k < n; ++k) {
+                double x = double(i) - c, y = double(j) - c, z = double(k) - c;
+                dense.unchecked(i, j, k) = x * x + y * y + z * z < r * r ? 1.0 : 0.0;
+            }
         }
-        return { slice };
     }
+    SparseArray3d<double> sparse(1, 1, 1);
+    double ms = measureMs([&] { sparse = SparseArray3d<double>::fromDense(dense); });
+    cout << "sparse, fromDense  " << ms << " ms, " << sparse.memoryBytes() / 1024 << " KB vs "
+         << dense.size() * sizeof(double) / 1024 << " KB" << endl;
+    double total = 0;
+    ms = measureMs([&] { sparse.forEachActive([&](size_t, size_t, size_t, double v) { total += v; }); });
+    cout << "sparse, active sum " << ms << " ms (" << total << ")" << endl;
+    ms = measureMs([&] { Array3d back = sparse.toDense(); });
+    cout << "sparse, toDense    " << ms << " ms" << endl;
+}
 
-    // Установка значений для среза по первой координате
-    void SetValues0(int i, const vector<vector<double>>& values) {
-        if (i < 0 || i >= dim0) {
-            throw out_of_range("Индекс i выходит за пределы массива");
-        }
-        for (int j = 0; j < dim1; ++j) {
-            for (int k = 0; k < dim2; ++k) {
-                data[getIndex(i, j, k)] = values[j][k];
+// Заполнение и текстовый вывод: прежний поток с setprecision против exportText
+void benchExport(size_t n) {
+    Array3d a(n, n, n);
+    double ms = measureMs([&] { a.fill(0.5); });
+    cout << "fill               " << ms << " ms, " << double(a.size() * sizeof(double)) / 1e9 / (ms / 1000) << " GB/s" << endl;
+    ms = measureMs([&] {
+        ofstream out("bench.txt");
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                for (double value : a.axis2(i, j)) {
+                    out << fixed << setprecision(2) << value << " ";
+                }
+                out << endl;
             }
+            out << endl;
         }
+    });
+    cout << "text, iostream     " << ms << " ms" << endl;
+    ms = measureMs([&] { a.exportText("bench.txt", 2); });
+    cout << "text, exportText   " << ms << " ms" << endl;
+    remove("bench.txt");
+}
+
+// Проверка массивов больше 2^31 элементов и защиты от переполнения размеров
+int stressLarge() {
+    int failures = 0;
+    auto check = [&](bool ok, const char* what) {
+        cout << (ok ? "[ok]   " : "[FAIL] ") << what << endl;
+        failures += ok ? 0 : 1;
+    };
+
+    // 2048 x 2048 x 600 = 2 516 582 400 элементов: больше, чем помещается в int
+    BasicArray3d<uint8_t, RowMajorLayout, ZeroPageAllocator<uint8_t>> big(2048, 2048, 600);
+    check(big.size() == size_t(2048) * 2048 * 600, "size() без переполнения");
+    check(big(2047, 2047, 599) == 0, "новые страницы нулевые");
+    big(2047, 2047, 599) = 42;
+    big(1500, 3, 7) = 7;
+    check(size_t(&big(2047, 2047, 599) - big.storage()) == big.size() - 1, "последний элемент в конце хранилища");
+    check(big.GetValues12(2047, 599)[0][2047] == 42, "срез вдоль первой оси за границей 2^31");
+    check(big.GetValues01(1500, 3)[0][7] == 7, "срез вдоль третьей оси");
+
+    BasicArray3d<uint8_t, TiledLayout<8>, ZeroPageAllocator<uint8_t>> tiled(2048, 2048, 600);
+    tiled(2047, 1, 599) = 5;
+    check(tiled.GetValues02(2047, 599)[0][1] == 5, "блочное размещение за границей 2^31");
+
+    bool thrown = false;
+    try {
+        Array3d huge(size_t(1) << 32, size_t(1) << 32, 2);
     }
+    catch (const overflow_error&) {
+        thrown = true;
+    }
+    check(thrown, "переполнение размеров обнаружено в конструкторе");
 
-    // Установка значений для среза по второй координате
-    void SetValues1(int j, const vector<vector<double>>& values) {
-        if (j < 0 || j >= dim1) {
-            throw out_of_range("Индекс j выходит за пределы массива");
-        }
-        for (int i = 0; i < dim0; ++i) {
-            for (int k = 0; k < dim2; ++k) {
-                data[getIndex(i, j, k)] = values[i][k];
-            }
-        }
+    thrown = false;
+    try {
+        Array3d huge(size_t(1) << 30, size_t(1) << 30, 8); // 2^63 элементов помещаются, а 2^66 байт - нет
+    }
+    catch (const overflow_error&) {
+        thrown = true;
     }
+    check(thrown, "переполнение объема в байтах обнаружено в конструкторе");
 
-    // Установка значений для среза по третьей координате
-    void SetValues2(int k, const vector<vector<double>>& values) {
-        if (k < 0 || k >= dim2) {
-            throw out_of_range("Индекс k выходит за пределы массива");
-        }
-        for (int i = 0; i < dim0; ++i) {
-            for (int j = 0; j < dim1; ++j) {
-                data[getIndex(i, j, k)] = values[i][j];
+    return failures == 0 ? 0 : 1;
+}
+
+// Проверка поврежденного блочного файла: ошибка распаковки в рабочем потоке
+// должна дойти до вызывающего как runtime_error, а не завершить процесс
+int stressCorruptChunks() {
+    int failures = 0;
+    auto check = [&](bool ok, const char* what) {
+        cout << (ok ? "[ok]   " : "[FAIL] ") << what << endl;
+        failures += ok ? 0 : 1;
+    };
+
+    const size_t n = 64;
+    Array3d a(n, n, n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t k = 0; k < n; ++k) {
+                a.unchecked(i, j, k) = double((i * 31 + j * 17 + k * 7) % 101);
             }
         }
     }
-
-    // Установка значений для среза по первой и второй координатам
-    void SetValues01(int i, int j, const vector<double>& values) {
-        if (i < 0 || i >= dim0 || j < 0 || j >= dim1) {
-            throw out_of_range("Индексы i или j выходят за пределы массива");
-        }
-        for (int k = 0; k < dim2; ++k) {
-            data[getIndex(i, j, k)] = values[k];
+    const char* path = "stress.a3c";
+    saveChunked(a, path, 16); // 64 кубика
+    {
+        // портим данные кубиков в нескольких местах (таблица смещений в конце файла цела)
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekg(0, ios::end);
+        size_t dataEnd = size_t(file.tellg()) - (4 * 4 * 4 + 1) * sizeof(uint64_t);
+        size_t dataStart = sizeof(ChunkedFileHeader);
+        const string garbage(16, char(0xFF));
+        for (size_t part = 1; part < 4; ++part) {
+            file.seekp(streamoff(dataStart + (dataEnd - dataStart) * part / 4));
+            file.write(garbage.data(), streamsize(garbage.size()));
         }
     }
 
-    // Установка значений для среза по первой и третьей координатам
-    void SetValues02(int i, int k, const vector<double>& values) {
-        if (i < 0 || i >= dim0 || k < 0 || k >= dim2) {
-            throw out_of_range("Индексы i или k выходят за пределы массива");
-        }
-        for (int j = 0; j < dim1; ++j) {
-            data[getIndex(i, j, k)] = values[j];
-        }
+    setWorkerCount(8); // многопоточный путь и на машине с одним ядром
+    bool thrown = false;
+    try {
+        ChunkedArray3d<double> chunked(path);
+        chunked.load();
+    }
+    catch (const runtime_error&) {
+        thrown = true;
     }
+    check(thrown, "поврежденный кубик при полной распаковке в 8 потоках - runtime_error");
 
-    // Установка значений для среза по второй и третьей координатам
-    void SetValues12(int j, int k, const vector<double>& values) {
-        if (j < 0 || j >= dim1 || k < 0 || k >= dim2) {
-            throw out_of_range("Индексы j или k выходят за пределы массива");
-        }
-        for (int i = 0; i < dim0; ++i) {
-            data[getIndex(i, j, k)] = values[i];
+    thrown = false;
+    try {
+        ChunkedArray3d<double> chunked(path);
+        for (size_t i = 0; i < n; i += 16) {
+            chunked.GetValues0(i);
         }
     }
-
-    // Метод для создания массива, заполненного нулями
-    void zeros() {
-        fill(data.begin(), data.end(), 0.0);
+    catch (const runtime_error&) {
+        thrown = true;
     }
+    check(thrown, "поврежденный кубик при чтении срезов в 8 потоках - runtime_error");
+    setWorkerCount(0);
 
-    // Метод для создания массива, заполненного единицами
-    void ones() {
-        fill(data.begin(), data.end(), 1.0);
-    }
+    remove(path);
+    return failures == 0 ? 0 : 1;
+}
 
-    // Метод для заполнения массива заданным значением
-    void fill(double value) {
-        fill(data.begin(), data.end(), value);
+// Основная функция для тестирования класса
+// Запуск с аргументом bench выполняет замеры, stress - проверку больших объемов
+// и поврежденных файлов
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "stress") {
+        int large = stressLarge();
+        int corrupt = stressCorruptChunks();
+        return large != 0 || corrupt != 0 ? 1 : 0;
     }
 
-    // Метод для вывода массива (для отладки)
-    void print() const {
-        for (int i = 0; i < dim0; ++i) {
-            for (int j = 0; j < dim1; ++j) {
-                for (int k = 0; k < dim2; ++k) {
-                    cout << fixed << setprecision(2) << (*this)(i, j, k) << " ";
-                }
-                cout << endl;
-            }
-            cout << endl;
-        }
+    if (argc > 1 && string(argv[1]) == "bench") {
+        int n = argc > 2 ? stoi(argv[2]) : 256;
+        benchSlices<RowMajorLayout>(n);
+        benchSlices<TiledLayout<8>>(n);
+        benchSlices<MortonLayout>(n);
+        benchArithmetic(size_t(n));
+        benchChunked(size_t(n));
+        benchStencil(size_t(n));
+        benchPermute(size_t(n));
+        benchSparse(size_t(n));
+        benchExport(size_t(n));
+        return 0;
     }
-};
 
-// Основная функция для тестирования класса
-int main() {
     // Создание объекта Array3d размером 3x3x3
     Array3d array(3, 3, 3);
 
@@ -230,5 +330,22 @@ int main() {
     cout << "Массив после установки значений среза (i=1, j=1):" << endl;
     array.print();
 
+    // Сохранение в файл и открытие через отображение в память
+    array.saveMapped("array.a3d");
+    {
+        Array3d mapped = Array3d::openMapped("array.a3d", MapMode::CopyOnWrite);
+        mapped(0, 0, 0) = 9.0; // меняется только копия страницы в памяти, файл остается прежним
+        cout << "Срез (i=1, j=1) из отображенного файла:" << endl;
+        exportText(cout, mapped.GetValues01(1, 1));
+    } // отображение закрыто - файл можно удалить (в Windows открытый файл не удаляется)
+    remove("array.a3d");
+
+    // Массив байтов (например, данные датчика) занимает в 8 раз меньше памяти
+    Array3dU8 bytes(2, 2, 2);
+    bytes.fill(7);
+    bytes.SetValues12(0, 1, { 1, 2 });
+    cout << "Массив uint8_t:" << endl;
+    bytes.print();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+using namespace std;
+
+// Выделение памяти с заданным выравниванием (кроссплатформенно)
+inline void* alignedAlloc(size_t bytes, size_t align) {
+    if (bytes == 0) {
+        bytes = align;
+    }
+#ifdef _WIN32
+    void* p = _aligned_malloc(bytes, align);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, align, bytes) != 0) {
+        p = nullptr;
+    }
+#endif
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+inline void alignedFree(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// Распределитель с выравниванием по Align байт (по умолчанию - по строке кэша)
+template <typename T, size_t Align = 64>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() noexcept {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > size_t(-1) / sizeof(T)) {
+            throw bad_alloc();
+        }
+        return static_cast<T*>(alignedAlloc(n * sizeof(T), Align));
+    }
+
+    void deallocate(T* p, size_t) noexcept { alignedFree(p); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Align>&) const noexcept { return false; }
+};
+
+// Распределитель для очень больших объемов: память выравнивается по 2 МБ,
+// и на Linux ядру подсказывается использовать большие страницы (transparent huge pages).
+// На остальных системах работает как обычное выравненное выделение.
+template <typename T>
+class HugePageAllocator {
+public:
+    using value_type = T;
+    static constexpr size_t hugePage = size_t(2) << 20;
+
+    template <typename U>
+    struct rebind { using other = HugePageAllocator<U>; };
+
+    HugePageAllocator() noexcept {}
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > size_t(-1) / sizeof(T) - hugePage) {
+            throw bad_alloc();
+        }
+        size_t bytes = n * sizeof(T);
+        if (bytes < hugePage) {
+            return static_cast<T*>(alignedAlloc(bytes, 64)); // маленьким объемам большие страницы не нужны
+        }
+        bytes = (bytes + hugePage - 1) / hugePage * hugePage;
+        void* p = alignedAlloc(bytes, hugePage);
+#ifdef MADV_HUGEPAGE
+        madvise(p, bytes, MADV_HUGEPAGE); // только подсказка: ошибку можно игнорировать
+#endif
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) noexcept { alignedFree(p); }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const HugePageAllocator<U>&) const noexcept { return false; }
+};
+
+// Распределитель для объемов в десятки гигабайт: память берется напрямую у ОС
+// (mmap / VirtualAlloc), физические страницы выделяются только при первом обращении
+// и уже заполнены нулями. Поэтому construct() без аргументов ничего не пишет,
+// и создание массива на 2048^3 элементов не трогает ни одной страницы.
+template <typename T>
+class ZeroPageAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = ZeroPageAllocator<U>; };
+
+    ZeroPageAllocator() noexcept {}
+    template <typename U>
+    ZeroPageAllocator(const ZeroPageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > size_t(-1) / sizeof(T)) {
+            throw bad_alloc();
+        }
+        size_t bytes = n == 0 ? sizeof(T) : n * sizeof(T);
+#ifdef _WIN32
+        void* p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (p == nullptr) {
+            throw bad_alloc();
+        }
+#else
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            throw bad_alloc();
+        }
+#endif
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+#ifdef _WIN32
+        (void)n;
+        VirtualFree(p, 0, MEM_RELEASE);
+#else
+        munmap(p, n == 0 ? sizeof(T) : n * sizeof(T));
+#endif
+    }
+
+    // Страницы от ОС уже нулевые - инициализация по умолчанию ничего не записывает
+    template <typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const ZeroPageAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const ZeroPageAllocator<U>&) const noexcept { return false; }
+};
@@ -0,0 +1,892 @@
+﻿#pragma once
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <iomanip> // Для работы с форматированием вывода
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <array>
+#include "layout.hpp"
+#include "alloc.hpp"
+#include "buffer.hpp"
+#include "parallel.hpp"
+#include "expr.hpp"
+#include "permute.hpp"
+#include "textio.hpp"
+using namespace std;
+
+template <typename Array>
+class ReadOnlyArray;
+
+// Трехмерный массив элементов типа T с выбираемой политикой размещения (см. layout.hpp)
+// и распределителем памяти (по умолчанию выравнивание по 64 байта, см. alloc.hpp)
+template <typename T = double, typename Layout = RowMajorLayout, typename Allocator = AlignedAllocator<T>>
+class BasicArray3d {
+    static_assert(is_arithmetic<T>::value, "Array3d хранит только арифметические типы");
+
+private:
+    size_t dim0, dim1, dim2;  // Размеры массива (64-битные, чтобы объем мог превышать 2^31)
+    Layout layout;         // Правило перевода (i, j, k) в позицию хранилища
+    array<int, 3> order = { { 0, 1, 2 } }; // из какой исходной оси получена каждая ось (после permute)
+    Buffer<T, Allocator> data; // Одномерный контейнер для хранения элементов (память или файл)
+
+    // Функция для перевода трехмерных индексов в одномерный
+    size_t getIndex(size_t i, size_t j, size_t k) const {
+        if (i >= dim0 || j >= dim1 || k >= dim2) {
+            throw out_of_range("Индексы выходят за пределы массива");
+        }
+        return layout.offset(i, j, k);
+    }
+
+    // Перевод индексов без проверки границ (проверка остается только в отладочной сборке)
+    size_t getIndexUnchecked(size_t i, size_t j, size_t k) const {
+#ifdef _DEBUG
+        return getIndex(i, j, k);
+#else
+        return layout.offset(i, j, k);
+#endif
+    }
+
+    // Смещение вдоль выбранной оси
+    template <int Axis>
+    size_t axisOffset(size_t n) const {
+        if (Axis == 0) return layout.offset0(n);
+        if (Axis == 1) return layout.offset1(n);
+        return layout.offset2(n);
+    }
+
+public:
+    // Итератор вдоль одной оси: база (вклад двух фиксированных индексов) плюс вклад бегущего индекса
+    template <typename V, int Axis>
+    class AxisIterator {
+    private:
+        V* base;
+        const BasicArray3d* owner;
+        size_t pos;
+
+    public:
+        using iterator_category = random_access_iterator_tag;
+        using value_type = remove_const_t<V>;
+        using difference_type = ptrdiff_t;
+        using pointer = V*;
+        using reference = V&;
+
+        AxisIterator() : base(nullptr), owner(nullptr), pos(0) {}
+        AxisIterator(V* b, const BasicArray3d* o, size_t p) : base(b), owner(o), pos(p) {}
+
+        V& operator*() const { return base[owner->template axisOffset<Axis>(pos)]; }
+        V& operator[](ptrdiff_t n) const { return base[owner->template axisOffset<Axis>(pos + size_t(n))]; }
+        AxisIterator& operator++() { ++pos; return *this; }
+        AxisIterator operator++(int) { AxisIterator tmp = *this; ++pos; return tmp; }
+        AxisIterator& operator--() { --pos; return *this; }
+        AxisIterator operator--(int) { AxisIterator tmp = *this; --pos; return tmp; }
+        AxisIterator& operator+=(ptrdiff_t n) { pos += size_t(n); return *this; }
+        AxisIterator& operator-=(ptrdiff_t n) { pos -= size_t(n); return *this; }
+        AxisIterator operator+(ptrdiff_t n) const { return AxisIterator(base, owner, pos + size_t(n)); }
+        friend AxisIterator operator+(ptrdiff_t n, const AxisIterator& it) { return it + n; }
+        AxisIterator operator-(ptrdiff_t n) const { return AxisIterator(base, owner, pos - size_t(n)); }
+        ptrdiff_t operator-(const AxisIterator& other) const { return ptrdiff_t(pos) - ptrdiff_t(other.pos); }
+        bool operator==(const AxisIterator& other) const { return pos == other.pos; }
+        bool operator!=(const AxisIterator& other) const { return pos != other.pos; }
+        bool operator<(const AxisIterator& other) const { return pos < other.pos; }
+        bool operator<=(const AxisIterator& other) const { return pos <= other.pos; }
+        bool operator>(const AxisIterator& other) const { return pos > other.pos; }
+        bool operator>=(const AxisIterator& other) const { return pos >= other.pos; }
+    };
+
+    // Диапазон элементов вдоль одной оси (для range-based for)
+    template <typename V, int Axis>
+    class AxisRange {
+    private:
+        V* base;
+        const BasicArray3d* owner;
+        size_t count;
+
+    public:
+        AxisRange(V* b, const BasicArray3d* o, size_t n) : base(b), owner(o), count(n) {}
+
+        AxisIterator<V, Axis> begin() const { return AxisIterator<V, Axis>(base, owner, 0); }
+        AxisIterator<V, Axis> end() const { return AxisIterator<V, Axis>(base, owner, count); }
+        size_t size() const { return count; }
+        V& operator[](size_t n) const { return base[owner->template axisOffset<Axis>(n)]; }
+    };
+
+    // Итератор по всем ячейкам в логическом порядке (i, j, k) для размещений с выравниванием
+    template <typename V>
+    class CellIterator {
+    private:
+        V* base;
+        const BasicArray3d* owner;
+        size_t i, j, k;
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = remove_const_t<V>;
+        using difference_type = ptrdiff_t;
+        using pointer = V*;
+        using reference = V&;
+
+        CellIterator(V* b, const BasicArray3d* o, size_t i0) : base(b), owner(o), i(i0), j(0), k(0) {}
+
+        V& operator*() const { return base[owner->layout.offset(i, j, k)]; }
+        CellIterator& operator++() {
+            if (++k == owner->dim2) {
+                k = 0;
+                if (++j == owner->dim1) {
+                    j = 0;
+                    ++i;
+                }
+            }
+            return *this;
+        }
+        CellIterator operator++(int) { CellIterator tmp = *this; ++(*this); return tmp; }
+        bool operator==(const CellIterator& other) const { return i == other.i && j == other.j && k == other.k; }
+        bool operator!=(const CellIterator& other) const { return !(*this == other); }
+    };
+
+    // Для плотного размещения логический порядок совпадает с порядком хранения - хватает указателя
+    using iterator = conditional_t<Layout::dense, T*, CellIterator<T>>;
+    using const_iterator = conditional_t<Layout::dense, const T*, CellIterator<const T>>;
+
+    // Конструктор для создания массива заданных размеров
+    BasicArray3d(size_t d0, size_t d1, size_t d2) : dim0(d0), dim1(d1), dim2(d2) {
+        layout.init(d0, d1, d2); // бросает overflow_error, если объем не помещается в size_t
+        checkedMul(layout.size(), sizeof(T));
+        data = Buffer<T, Allocator>(layout.size());
+    }
+
+    // Создание массива из выражения (a + b * 2.0 и т.п.) за один проход
+    template <typename E, typename = enable_if_t<IsArrayExpr<E>::value>>
+    BasicArray3d(const E& expr) : BasicArray3d(expr.size0(), expr.size1(), expr.size2()) {
+        assign(expr);
+    }
+
+    // Присваивание выражения той же формы
+    template <typename E, typename = enable_if_t<IsArrayExpr<E>::value>>
+    BasicArray3d& operator=(const E& expr) {
+        if (expr.size0() != dim0 || expr.size1() != dim1 || expr.size2() != dim2) {
+            throw invalid_argument("Размеры массивов в выражении не совпадают");
+        }
+        assign(expr);
+        return *this;
+    }
+
+    // Составное присваивание с массивом, выражением или числом
+    template <typename X>
+    BasicArray3d& operator+=(const X& x) { return *this = *this + x; }
+    template <typename X>
+    BasicArray3d& operator-=(const X& x) { return *this = *this - x; }
+    template <typename X>
+    BasicArray3d& operator*=(const X& x) { return *this = *this * x; }
+    template <typename X>
+    BasicArray3d& operator/=(const X& x) { return *this = *this / x; }
+
+    // Массив поверх файла, отображенного в память (формат saveMapped/createMapped).
+    // Открытие мгновенное: страницы читаются с диска только при обращении к ним.
+    // Только для чтения - openMapped(path): страницы защищены от записи, поэтому массив
+    // выдается через ReadOnlyArray, где доступ к нему только константный
+    static ReadOnlyArray<BasicArray3d> openMapped(const string& path) {
+        return ReadOnlyArray<BasicArray3d>(mapFile(path, MapMode::ReadOnly));
+    }
+
+    // Изменяемый массив поверх файла: CopyOnWrite или ReadWrite
+    static BasicArray3d openMapped(const string& path, MapMode mode) {
+        if (mode == MapMode::ReadOnly) {
+            throw invalid_argument("Массив только для чтения открывается через openMapped(path)");
+        }
+        return mapFile(path, mode);
+    }
+
+    // Создание файла нужного размера (заполнен нулями) и отображение его на чтение и запись
+    static BasicArray3d createMapped(const string& path, size_t d0, size_t d1, size_t d2) {
+        Layout probe;
+        probe.init(d0, d1, d2);
+        size_t bytes = checkedMul(probe.size(), sizeof(T));
+        auto file = make_shared<MappedFile>(path, MapMode::ReadWrite, array3dDataOffset + bytes);
+        Array3dFileHeader header = makeHeader(d0, d1, d2);
+        memcpy(file->data(), &header, sizeof(header));
+        return BasicArray3d(d0, d1, d2, move(file), array3dDataOffset, path);
+    }
+
+    // Сохранение массива в файл, который можно открыть через openMapped
+    void saveMapped(const string& path) const {
+        ofstream out(path, ios::binary);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл: " + path);
+        }
+        Array3dFileHeader header = makeHeader(dim0, dim1, dim2);
+        vector<char> head(array3dDataOffset, 0);
+        memcpy(head.data(), &header, sizeof(header));
+        out.write(head.data(), streamsize(head.size()));
+        out.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size() * sizeof(T)));
+        if (!out) {
+            throw runtime_error("Ошибка записи в файл: " + path);
+        }
+    }
+
+    // Лежат ли данные в отображенном файле
+    bool isMapped() const { return data.mapping() != nullptr; }
+
+    // Порядок осей: axes()[n] - номер оси исходных данных, которая стала осью n
+    const array<int, 3>& axes() const { return order; }
+
+    // Перестановка осей: ось n результата - ось axes[n] этого массива.
+    // Например, permute({ 2, 0, 1 }) делает третью ось первой, а непрерывной - вторую.
+    // Для построчного размещения используется кэш-независимая рекурсия (permute.hpp),
+    // старшая ось результата делится между потоками
+    BasicArray3d permute(const array<int, 3>& axes) const {
+        checkAxes(axes);
+        size_t dims[3] = { dim0, dim1, dim2 };
+        BasicArray3d result(dims[axes[0]], dims[axes[1]], dims[axes[2]]);
+        for (int n = 0; n < 3; ++n) {
+            result.order[n] = order[axes[n]];
+        }
+        if (result.size() == 0) {
+            return result;
+        }
+        if (is_same<Layout, RowMajorLayout>::value) {
+            ptrdiff_t strides[3] = { ptrdiff_t(dim1 * dim2), ptrdiff_t(dim2), 1 };
+            array<ptrdiff_t, 3> srcStride = { { strides[axes[0]], strides[axes[1]], strides[axes[2]] } };
+            array<size_t, 3> dstStride = { { result.dim1 * result.dim2, result.dim2, 1 } };
+            const T* src = data.data();
+            T* dst = result.data.data();
+            parallelFor(result.dim0, [&](size_t begin, size_t end) {
+                permuteBlock(src, dst, srcStride, dstStride, { { begin, 0, 0 } }, { { end, result.dim1, result.dim2 } });
+            }, std::max<size_t>(1, (size_t(1) << 15) / std::max<size_t>(1, result.dim1 * result.dim2)));
+            return result;
+        }
+        // Другие размещения: поэлементно, через вклады осей
+        parallelFor(result.dim0, [&](size_t begin, size_t end) {
+            size_t x[3];
+            for (x[0] = begin; x[0] < end; ++x[0]) {
+                for (x[1] = 0; x[1] < result.dim1; ++x[1]) {
+                    for (x[2] = 0; x[2] < result.dim2; ++x[2]) {
+                        size_t c[3];
+                        c[axes[0]] = x[0];
+                        c[axes[1]] = x[1];
+                        c[axes[2]] = x[2];
+                        result.unchecked(x[0], x[1], x[2]) = unchecked(c[0], c[1], c[2]);
+                    }
+                }
+            }
+        }, planeGrain());
+        return result;
+    }
+
+    // Перестановка осей на месте (только для куба). Обмен двух осей - попарные обмены
+    // ячеек плитками; циклический сдвиг осей - проход по циклам длины 3, каждый цикл
+    // обрабатывает поток, которому принадлежит его наименьшая ячейка
+    void permuteInPlace(const array<int, 3>& axes) {
+        checkAxes(axes);
+        if (dim0 != dim1 || dim1 != dim2) {
+            throw invalid_argument("Перестановка на месте возможна только для куба");
+        }
+        size_t n = dim0;
+        // Источник для ячейки x: координата по оси axes[m] равна x[m]
+        auto source = [&](const array<size_t, 3>& x) {
+            array<size_t, 3> c;
+            c[axes[0]] = x[0];
+            c[axes[1]] = x[1];
+            c[axes[2]] = x[2];
+            return c;
+        };
+        auto offsetOf = [&](const array<size_t, 3>& x) { return layout.offset(x[0], x[1], x[2]); };
+        T* p = data.data();
+        bool identity = axes[0] == 0 && axes[1] == 1 && axes[2] == 2;
+        int fixed = axes[0] == 0 ? 0 : axes[1] == 1 ? 1 : axes[2] == 2 ? 2 : -1; // ось, оставшаяся на месте
+        if (identity) {
+            return;
+        }
+        if (fixed >= 0) {
+            // Обмен двух осей a и b: циклы длины 2, меняем ячейки с x[a] < x[b] местами.
+            // Обход плитками по (a, b), чтобы обе половины обмена оставались в кэше
+            int a = fixed == 0 ? 1 : 0, b = fixed == 2 ? 1 : 2;
+            const size_t tile = 16;
+            size_t tiles = (n + tile - 1) / tile;
+            parallelFor(tiles, [&](size_t begin, size_t end) {
+                array<size_t, 3> x, y;
+                for (size_t ta = begin; ta < end; ++ta) {
+                    for (size_t tb = ta; tb < tiles; ++tb) {
+                        for (x[fixed] = 0; x[fixed] < n; ++x[fixed]) {
+                            for (x[a] = ta * tile; x[a] < std::min(n, ta * tile + tile); ++x[a]) {
+                                for (x[b] = std::max(tb * tile, x[a] + 1); x[b] < std::min(n, tb * tile + tile); ++x[b]) {
+                                    y = x;
+                                    swap(y[a], y[b]);
+                                    swap(p[offsetOf(x)], p[offsetOf(y)]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }, 1);
+        }
+        else {
+            parallelFor(n, [&](size_t begin, size_t end) {
+                array<size_t, 3> x;
+                for (x[0] = begin; x[0] < end; ++x[0]) {
+                    for (x[1] = 0; x[1] < n; ++x[1]) {
+                        for (x[2] = 0; x[2] < n; ++x[2]) {
+                            size_t start = offsetOf(x);
+                            // ищем наименьшую ячейку цикла; если это не мы - цикл обработает другой
+                            bool leader = true;
+                            for (array<size_t, 3> y = source(x); y != x; y = source(y)) {
+                                if (offsetOf(y) < start) {
+                                    leader = false;
+                                    break;
+                                }
+                            }
+                            if (!leader) {
+                                continue;
+                            }
+                            T first = p[start];
+                            array<size_t, 3> cur = x;
+                            for (array<size_t, 3> next = source(cur); next != x; next = source(next)) {
+                                p[offsetOf(cur)] = p[offsetOf(next)];
+                                cur = next;
+                            }
+                            p[offsetOf(cur)] = first;
+                        }
+                    }
+                }
+            }, planeGrain());
+        }
+        array<int, 3> old = order;
+        for (int m = 0; m < 3; ++m) {
+            order[m] = old[axes[m]];
+        }
+    }
+
+    // Индексатор для доступа к элементам массива по трехмерным индексам
+    T& operator()(size_t i, size_t j, size_t k) {
+        return data[getIndex(i, j, k)];
+    }
+
+    const T& operator()(size_t i, size_t j, size_t k) const {
+        return data[getIndex(i, j, k)];
+    }
+
+    // Доступ без проверки границ для горячих циклов
+    T& unchecked(size_t i, size_t j, size_t k) {
+        return data[getIndexUnchecked(i, j, k)];
+    }
+
+    const T& unchecked(size_t i, size_t j, size_t k) const {
+        return data[getIndexUnchecked(i, j, k)];
+    }
+
+    // Размеры массива
+    size_t size0() const { return dim0; }
+    size_t size1() const { return dim1; }
+    size_t size2() const { return dim2; }
+    size_t size() const { return size_t(dim0) * dim1 * dim2; }
+
+    // Сырое хранилище (для массовых операций; может содержать выравнивающие ячейки)
+    T* storage() { return data.data(); }
+    const T* storage() const { return data.data(); }
+    size_t storageSize() const { return data.size(); }
+
+    // Итераторы по всем элементам в логическом порядке (i, j, k)
+    iterator begin() { return makeIterator<T>(data.data(), 0); }
+    iterator end() { return makeIterator<T>(data.data(), dim0); }
+    const_iterator begin() const { return makeIterator<const T>(data.data(), 0); }
+    const_iterator end() const { return makeIterator<const T>(data.data(), dim0); }
+
+    // Проход вдоль первой оси при фиксированных j и k
+    AxisRange<T, 0> axis0(size_t j, size_t k) {
+        return AxisRange<T, 0>(data.data() + getIndex(0, j, k), this, dim0);
+    }
+
+    AxisRange<const T, 0> axis0(size_t j, size_t k) const {
+        return AxisRange<const T, 0>(data.data() + getIndex(0, j, k), this, dim0);
+    }
+
+    // Проход вдоль второй оси при фиксированных i и k
+    AxisRange<T, 1> axis1(size_t i, size_t k) {
+        return AxisRange<T, 1>(data.data() + getIndex(i, 0, k), this, dim1);
+    }
+
+    AxisRange<const T, 1> axis1(size_t i, size_t k) const {
+        return AxisRange<const T, 1>(data.data() + getIndex(i, 0, k), this, dim1);
+    }
+
+    // Проход вдоль третьей оси при фиксированных i и j
+    AxisRange<T, 2> axis2(size_t i, size_t j) {
+        return AxisRange<T, 2>(data.data() + getIndex(i, j, 0), this, dim2);
+    }
+
+    AxisRange<const T, 2> axis2(size_t i, size_t j) const {
+        return AxisRange<const T, 2>(data.data() + getIndex(i, j, 0), this, dim2);
+    }
+    // Получение среза по первой координате
+    vector<vector<T>> GetValues0(size_t i) const {
+        if (i >= dim0) {
+            throw out_of_range("Индекс i выходит за пределы массива");
+        }
+        adviseSlice(0, i);
+        vector<vector<T>> slice(dim1);
+        for (size_t j = 0; j < dim1; ++j) {
+            auto row = axis2(i, j);
+            slice[j].assign(row.begin(), row.end());
+        }
+        return slice;
+    }
+
+    // Получение среза по второй координате
+    vector<vector<T>> GetValues1(size_t j) const {
+        if (j >= dim1) {
+            throw out_of_range("Индекс j выходит за пределы массива");
+        }
+        adviseSlice(1, j);
+        vector<vector<T>> slice(dim0);
+        for (size_t i = 0; i < dim0; ++i) {
+            auto row = axis2(i, j);
+            slice[i].assign(row.begin(), row.end());
+        }
+        return slice;
+    }
+
+    // Получение среза по третьей координате
+    vector<vector<T>> GetValues2(size_t k) const {
+        if (k >= dim2) {
+            throw out_of_range("Индекс k выходит за пределы массива");
+        }
+        adviseSlice(2, k);
+        vector<vector<T>> slice(dim0);
+        for (size_t i = 0; i < dim0; ++i) {
+            auto col = axis1(i, k);
+            slice[i].assign(col.begin(), col.end());
+        }
+        return slice;
+    }
+
+    // Получение среза по первой и второй координатам
+    vector<vector<T>> GetValues01(size_t i, size_t j) const {
+        if (i >= dim0 || j >= dim1) {
+            throw out_of_range("Индексы i или j выходят за пределы массива");
+        }
+        auto line = axis2(i, j);
+        return { vector<T>(line.begin(), line.end()) };
+    }
+
+    // Получение среза по первой и третьей координатам
+    vector<vector<T>> GetValues02(size_t i, size_t k) const {
+        if (i >= dim0 || k >= dim2) {
+            throw out_of_range("Индексы i или k выходят за пределы массива");
+        }
+        auto line = axis1(i, k);
+        return { vector<T>(line.begin(), line.end()) };
+    }
+
+    // Получение среза по второй и третьей координатам
+    vector<vector<T>> GetValues12(size_t j, size_t k) const {
+        if (j >= dim1 || k >= dim2) {
+            throw out_of_range("Индексы j или k выходят за пределы массива");
+        }
+        auto line = axis0(j, k);
+        return { vector<T>(line.begin(), line.end()) };
+    }
+
+    // Установка значений для среза по первой координате
+    void SetValues0(size_t i, const vector<vector<T>>& values) {
+        if (i >= dim0) {
+            throw out_of_range("Индекс i выходит за пределы массива");
+        }
+        for (size_t j = 0; j < dim1; ++j) {
+            auto row = axis2(i, j);
+            copy_n(values[j].begin(), dim2, row.begin());
+        }
+    }
+
+    // Установка значений для среза по второй координате
+    void SetValues1(size_t j, const vector<vector<T>>& values) {
+        if (j >= dim1) {
+            throw out_of_range("Индекс j выходит за пределы массива");
+        }
+        for (size_t i = 0; i < dim0; ++i) {
+            auto row = axis2(i, j);
+            copy_n(values[i].begin(), dim2, row.begin());
+        }
+    }
+
+    // Установка значений для среза по третьей координате
+    void SetValues2(size_t k, const vector<vector<T>>& values) {
+        if (k >= dim2) {
+            throw out_of_range("Индекс k выходит за пределы массива");
+        }
+        for (size_t i = 0; i < dim0; ++i) {
+            auto col = axis1(i, k);
+            copy_n(values[i].begin(), dim1, col.begin());
+        }
+    }
+
+    // Установка значений для среза по первой и второй координатам
+    void SetValues01(size_t i, size_t j, const vector<T>& values) {
+        if (i >= dim0 || j >= dim1) {
+            throw out_of_range("Индексы i или j выходят за пределы массива");
+        }
+        auto line = axis2(i, j);
+        copy_n(values.begin(), dim2, line.begin());
+    }
+
+    // Установка значений для среза по первой и третьей координатам
+    void SetValues02(size_t i, size_t k, const vector<T>& values) {
+        if (i >= dim0 || k >= dim2) {
+            throw out_of_range("Индексы i или k выходят за пределы массива");
+        }
+        auto line = axis1(i, k);
+        copy_n(values.begin(), dim1, line.begin());
+    }
+
+    // Установка значений для среза по второй и третьей координатам
+    void SetValues12(size_t j, size_t k, const vector<T>& values) {
+        if (j >= dim1 || k >= dim2) {
+            throw out_of_range("Индексы j или k выходят за пределы массива");
+        }
+        auto line = axis0(j, k);
+        copy_n(values.begin(), dim0, line.begin());
+    }
+
+    // Метод для создания массива, заполненного нулями
+    void zeros() {
+        fill(T(0));
+    }
+
+    // Метод для создания массива, заполненного единицами
+    void ones() {
+        fill(T(1));
+    }
+
+    // Метод для заполнения массива заданным значением
+    // (заполняется все хранилище целиком, включая выравнивающие ячейки; куски - в разных потоках)
+    void fill(T value) {
+        T* p = data.data();
+        parallelFor(data.size(), [=](size_t begin, size_t end) {
+            std::fill(p + begin, p + end, value);
+        });
+    }
+
+    // Метод для вывода массива (для отладки)
+    void print() const {
+        exportText(cout, 2);
+    }
+
+    // Текстовый вывод всего массива: строки по третьей координате, плоскости разделены
+    // пустой строкой. Плоскости форматируются параллельно пачками и пишутся по порядку
+    void exportText(ostream& os, int precision = 2) const {
+        size_t batch = std::min(dim0, workerCount());
+        vector<string> planes(batch);
+        for (size_t first = 0; first < dim0; first += batch) {
+            size_t count = std::min(batch, dim0 - first);
+            parallelFor(count, [&](size_t begin, size_t end) {
+                for (size_t n = begin; n < end; ++n) {
+                    string& out = planes[n];
+                    out.clear();
+                    for (size_t j = 0; j < dim1; ++j) {
+                        for (T value : axis2(first + n, j)) {
+                            appendValue(out, value, precision);
+                        }
+                        out.push_back('\n');
+                    }
+                    out.push_back('\n');
+                }
+            }, 1);
+            for (size_t n = 0; n < count; ++n) {
+                os.write(planes[n].data(), streamsize(planes[n].size()));
+            }
+        }
+        os.flush();
+    }
+
+    void exportText(const string& path, int precision = 2) const {
+        ofstream out(path, ios::binary);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл " + path);
+        }
+        exportText(out, precision);
+    }
+
+    // Сумма всех элементов (накопление в double)
+    double sum() const {
+        return reduceCells(0.0, [](double acc, T v) { return acc + double(v); }, [](double a, double b) { return a + b; });
+    }
+
+    // Наименьший элемент
+    T min() const {
+        requireNotEmpty();
+        return reduceCells(numeric_limits<T>::max(), [](T acc, T v) { return v < acc ? v : acc; },
+            [](T a, T b) { return b < a ? b : a; });
+    }
+
+    // Наибольший элемент
+    T max() const {
+        requireNotEmpty();
+        return reduceCells(numeric_limits<T>::lowest(), [](T acc, T v) { return acc < v ? v : acc; },
+            [](T a, T b) { return a < b ? b : a; });
+    }
+
+    // Среднее значение
+    double mean() const {
+        return sum() / double(size());
+    }
+
+    // Свертки вдоль оси: результат - массив, у которого эта ось имеет длину 1
+    BasicArray3d<double, Layout> sum(int axis) const {
+        return reduceAxis<double>(axis, 0.0, [](double acc, T v) { return acc + double(v); });
+    }
+
+    BasicArray3d min(int axis) const {
+        requireNotEmpty();
+        return reduceAxis<T, BasicArray3d>(axis, numeric_limits<T>::max(), [](T acc, T v) { return v < acc ? v : acc; });
+    }
+
+    BasicArray3d max(int axis) const {
+        requireNotEmpty();
+        return reduceAxis<T, BasicArray3d>(axis, numeric_limits<T>::lowest(), [](T acc, T v) { return acc < v ? v : acc; });
+    }
+
+    BasicArray3d<double, Layout> mean(int axis) const {
+        size_t n = axis == 0 ? dim0 : axis == 1 ? dim1 : dim2;
+        BasicArray3d<double, Layout> result = sum(axis);
+        result *= 1.0 / double(n);
+        return result;
+    }
+
+private:
+    // Отображение файла и проверка заголовка (для openMapped)
+    static BasicArray3d mapFile(const string& path, MapMode mode) {
+        auto file = make_shared<MappedFile>(path, mode);
+        if (file->size() < sizeof(Array3dFileHeader)) {
+            throw runtime_error("Файл слишком мал для заголовка Array3d: " + path);
+        }
+        Array3dFileHeader header;
+        memcpy(&header, file->data(), sizeof(header));
+        if (memcmp(header.magic, "A3D1", 4) != 0) {
+            throw runtime_error("Файл не содержит Array3d: " + path);
+        }
+        if (header.elementCode != elementCode<T>() || header.layoutId != Layout::id) {
+            throw runtime_error("Тип элементов или размещение в файле не совпадают с массивом: " + path);
+        }
+        return BasicArray3d(size_t(header.dims[0]), size_t(header.dims[1]), size_t(header.dims[2]),
+            move(file), size_t(header.dataOffset), path);
+    }
+
+    // Массив поверх уже отображенного файла
+    BasicArray3d(size_t d0, size_t d1, size_t d2, shared_ptr<MappedFile> file, size_t offset, const string& path)
+        : dim0(d0), dim1(d1), dim2(d2) {
+        layout.init(d0, d1, d2);
+        size_t bytes = checkedMul(layout.size(), sizeof(T));
+        if (offset % alignof(T) != 0 || file->size() < offset || file->size() - offset < bytes) {
+            throw runtime_error("Размер файла не соответствует заголовку: " + path);
+        }
+        T* p = reinterpret_cast<T*>(file->data() + offset);
+        data = Buffer<T, Allocator>(p, layout.size(), move(file));
+    }
+
+    static Array3dFileHeader makeHeader(size_t d0, size_t d1, size_t d2) {
+        Array3dFileHeader header = {};
+        memcpy(header.magic, "A3D1", 4);
+        header.elementCode = elementCode<T>();
+        header.layoutId = Layout::id;
+        header.dims[0] = d0;
+        header.dims[1] = d1;
+        header.dims[2] = d2;
+        header.dataOffset = array3dDataOffset;
+        return header;
+    }
+
+    // Подсказка ОС перед чтением плоского среза из отображенного файла.
+    // Срез по первой оси - непрерывный кусок: просим подгрузить его заранее.
+    // По второй оси - d0 непрерывных строк: подгружаем их, если строка не меньше страницы,
+    // иначе срез задевает почти каждую страницу и выгоднее последовательное чтение.
+    // По третьей оси элементы идут с шагом d2: при шаге меньше страницы читаются
+    // все страницы подряд, при большем - по одной странице на строку вразброс.
+    void adviseSlice(int axis, size_t index) const {
+        const MappedFile* file = data.mapping();
+        if (file == nullptr || size() == 0) {
+            return;
+        }
+        size_t origin = size_t(reinterpret_cast<const char*>(data.data()) - file->data());
+        size_t page = MappedFile::pageSize();
+        size_t all = data.size() * sizeof(T);
+        if (!Layout::dense) {
+            file->advise(origin, all, MapAdvice::Random); // блоки мелкие, порядок страниц произвольный
+            return;
+        }
+        size_t row = dim2 * sizeof(T);
+        if (axis == 0) {
+            file->advise(origin + layout.offset(index, 0, 0) * sizeof(T), dim1 * row, MapAdvice::WillNeed);
+        }
+        else if (axis == 1) {
+            if (dim1 * row <= page) {
+                file->advise(origin, all, MapAdvice::Sequential);
+            }
+            else {
+                for (size_t i = 0; i < dim0; ++i) {
+                    file->advise(origin + layout.offset(i, index, 0) * sizeof(T), row, MapAdvice::WillNeed);
+                }
+            }
+        }
+        else {
+            file->advise(origin, all, row <= page ? MapAdvice::Sequential : MapAdvice::Random);
+        }
+    }
+
+    // Вычисление выражения в хранилище: один проход, куски по потокам,
+    // внутренний цикл по непрерывной памяти векторизуется компилятором
+    template <typename E>
+    void assign(const E& expr) {
+        static_assert(is_same<typename E::layout_type, Layout>::value, "Выражение должно иметь то же размещение, что и массив");
+        T* out = data.data();
+        parallelFor(data.size(), [&](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; ++n) {
+                out[n] = T(expr.at(n));
+            }
+        });
+    }
+
+    // Сколько плоскостей i отдавать потоку минимум, чтобы кусок был не меньше ~32K элементов
+    size_t planeGrain() const {
+        return std::max<size_t>(1, (size_t(1) << 15) / std::max<size_t>(dim1 * dim2, 1));
+    }
+
+    void requireNotEmpty() const {
+        if (size() == 0) {
+            throw out_of_range("Массив пуст");
+        }
+    }
+
+    // Свертка по всем логическим ячейкам; для плотного размещения - по хранилищу напрямую
+    template <typename R, typename F, typename Combine>
+    R reduceCells(R init, F f, Combine combine) const {
+        if (Layout::dense) {
+            const T* p = data.data();
+            return parallelReduce(data.size(), init, [&](size_t begin, size_t end, R acc) {
+                // четыре независимых накопителя, чтобы цепочка зависимостей не тормозила конвейер
+                R acc0 = acc, acc1 = acc, acc2 = acc, acc3 = acc;
+                size_t n = begin;
+                for (; n + 4 <= end; n += 4) {
+                    acc0 = f(acc0, p[n]);
+                    acc1 = f(acc1, p[n + 1]);
+                    acc2 = f(acc2, p[n + 2]);
+                    acc3 = f(acc3, p[n + 3]);
+                }
+                for (; n < end; ++n) {
+                    acc0 = f(acc0, p[n]);
+                }
+                return combine(combine(acc0, acc1), combine(acc2, acc3));
+            }, combine);
+        }
+        return parallelReduce(dim0, init, [&](size_t begin, size_t end, R acc) {
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t j = 0; j < dim1; ++j) {
+                    for (size_t k = 0; k < dim2; ++k) {
+                        acc = f(acc, unchecked(i, j, k));
+                    }
+                }
+            }
+            return acc;
+        }, combine, planeGrain());
+    }
+
+    // Свертка вдоль оси. Внутренний цикл всегда идет по третьей оси,
+    // чтобы для построчного размещения читать память подряд
+    template <typename R, typename Result = BasicArray3d<R, Layout>, typename F>
+    Result reduceAxis(int axis, R init, F f) const {
+        if (axis < 0 || axis > 2) {
+            throw out_of_range("Номер оси должен быть 0, 1 или 2");
+        }
+        Result result(axis == 0 ? 1 : dim0, axis == 1 ? 1 : dim1, axis == 2 ? 1 : dim2);
+        result.fill(init);
+        size_t grain = planeGrain();
+        if (axis == 0) {
+            // каждый поток отвечает за свои строки j результата
+            parallelFor(dim1, [&](size_t begin, size_t end) {
+                for (size_t i = 0; i < dim0; ++i) {
+                    for (size_t j = begin; j < end; ++j) {
+                        for (size_t k = 0; k < dim2; ++k) {
+                            result.unchecked(0, j, k) = f(result.unchecked(0, j, k), unchecked(i, j, k));
+                        }
+                    }
+                }
+            }, std::max<size_t>(1, (size_t(1) << 15) / std::max<size_t>(dim0 * dim2, 1)));
+        }
+        else if (axis == 1) {
+            parallelFor(dim0, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (size_t j = 0; j < dim1; ++j) {
+                        for (size_t k = 0; k < dim2; ++k) {
+                            result.unchecked(i, 0, k) = f(result.unchecked(i, 0, k), unchecked(i, j, k));
+                        }
+                    }
+                }
+            }, grain);
+        }
+        else {
+            parallelFor(dim0, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (size_t j = 0; j < dim1; ++j) {
+                        R acc = init;
+                        for (size_t k = 0; k < dim2; ++k) {
+                            acc = f(acc, unchecked(i, j, k));
+                        }
+                        result.unchecked(i, j, 0) = acc;
+                    }
+                }
+            }, grain);
+        }
+        return result;
+    }
+
+    template <typename V>
+    V* makeIterator(V* base, size_t i, true_type) const { return base + (i == dim0 ? size() : 0); }
+
+    template <typename V>
+    CellIterator<V> makeIterator(V* base, size_t i, false_type) const { return CellIterator<V>(base, this, i); }
+
+    template <typename V>
+    auto makeIterator(V* base, size_t i) const { return makeIterator(base, i, integral_constant<bool, Layout::dense>()); }
+};
+
+// Массив, доступный только для чтения (openMapped(path)): снаружи виден только
+// const Array&. Копия в обычный массив получает собственную память и изменяема
+template <typename Array>
+class ReadOnlyArray {
+private:
+    Array value;
+
+    explicit ReadOnlyArray(Array&& a) : value(move(a)) {}
+    friend Array;
+
+public:
+    const Array& get() const { return value; }
+    const Array& operator*() const { return value; }
+    const Array* operator->() const { return &value; }
+    operator const Array&() const { return value; }
+};
+
+// Массив как операнд выражения: лист, читающий его хранилище
+template <typename T, typename Layout, typename Allocator>
+struct ExprNode<BasicArray3d<T, Layout, Allocator>> {
+    using type = ArrayLeaf<T, Layout>;
+    static type make(const BasicArray3d<T, Layout, Allocator>& a) {
+        return type(a.storage(), a.size0(), a.size1(), a.size2(), a.storageSize());
+    }
+};
+
+// y = alpha * x + y за один проход
+template <typename T, typename Layout, typename Allocator, typename S>
+void axpy(S alpha, const BasicArray3d<T, Layout, Allocator>& x, BasicArray3d<T, Layout, Allocator>& y) {
+    y = alpha * x + y;
+}
+
+// Массив double с построчным размещением (поведение по умолчанию)
+using Array3d = BasicArray3d<double>;
+// Массивы для данных датчиков
+using Array3dF = BasicArray3d<float>;
+using Array3dU16 = BasicArray3d<uint16_t>;
+using Array3dU8 = BasicArray3d<uint8_t>;
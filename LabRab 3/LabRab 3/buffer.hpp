@@ -0,0 +1,97 @@
+﻿#pragma once
+#include <cstddef>
+#include <memory>
+#include <algorithm>
+#include "mapped.hpp"
+#include "parallel.hpp"
+using namespace std;
+
+// Хранилище элементов массива. Обычно память выделяется распределителем,
+// но хранилище может и смотреть в файл, отображенный в память (тогда оно
+// разделяет владение отображением). Копия всегда получает собственную память.
+template <typename T, typename Allocator>
+class Buffer {
+private:
+    T* ptr = nullptr;
+    size_t count = 0;
+    Allocator alloc;
+    shared_ptr<MappedFile> file; // не пусто, если данные лежат в отображенном файле
+
+    void release() {
+        if (ptr != nullptr && !file) {
+            alloc.deallocate(ptr, count);
+        }
+        ptr = nullptr;
+        count = 0;
+        file.reset();
+    }
+
+public:
+    Buffer() = default;
+
+    // Выделение n элементов; инициализация через распределитель (ZeroPageAllocator ничего не пишет).
+    // Инициализация идет кусками в нескольких потоках: страница достается узлу NUMA
+    // того потока, который первым ее коснулся, и память распределяется по узлам
+    explicit Buffer(size_t n) : count(n) {
+        ptr = alloc.allocate(n);
+        T* p = ptr;
+        Allocator& a = alloc;
+        parallelFor(n, [p, &a](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                allocator_traits<Allocator>::construct(a, p + i);
+            }
+        });
+    }
+
+    // Данные внутри отображенного файла
+    Buffer(T* p, size_t n, shared_ptr<MappedFile> mapping) : ptr(p), count(n), file(move(mapping)) {}
+
+    Buffer(const Buffer& other) : count(other.count) {
+        ptr = alloc.allocate(count);
+        T* dst = ptr;
+        const T* src = other.ptr;
+        parallelFor(count, [dst, src](size_t begin, size_t end) {
+            copy(src + begin, src + end, dst + begin);
+        });
+    }
+
+    Buffer(Buffer&& other) noexcept : ptr(other.ptr), count(other.count), file(move(other.file)) {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+
+    Buffer& operator=(const Buffer& other) {
+        if (this != &other) {
+            Buffer copy(other);
+            *this = move(copy);
+        }
+        return *this;
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            ptr = other.ptr;
+            count = other.count;
+            file = move(other.file);
+            other.ptr = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    ~Buffer() { release(); }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    T* begin() { return ptr; }
+    T* end() { return ptr + count; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    T& operator[](size_t n) { return ptr[n]; }
+    const T& operator[](size_t n) const { return ptr[n]; }
+
+    // Отображенный файл (nullptr для обычной памяти)
+    const MappedFile* mapping() const { return file.get(); }
+};
@@ -0,0 +1,466 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include "array3d.hpp"
+using namespace std;
+
+// Блочный формат хранения Array3d со сжатием.
+// Массив режется на кубики chunk x chunk x chunk (крайние - меньше), каждый кубик
+// сжимается отдельно встроенным кодеком (разность соседних значений + RLE + varint),
+// поэтому при чтении среза распаковываются только задетые им кубики.
+//
+// Файл: заголовок | сжатые кубики | таблица смещений (число кубиков + 1 значение)
+
+struct ChunkedFileHeader {
+    char magic[4];         // "A3C1"
+    uint32_t elementCode;  // см. elementCode<T>()
+    uint32_t chunk;        // длина ребра кубика
+    uint32_t reserved;
+    uint64_t dims[3];
+    uint64_t indexOffset;  // где лежит таблица смещений
+};
+
+// Целое без знака того же размера, что и T: кодек работает с битовым представлением
+template <typename T>
+using CodecWord = conditional_t<sizeof(T) == 1, uint8_t,
+    conditional_t<sizeof(T) == 2, uint16_t,
+    conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+inline void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+inline uint64_t getVarint(const uint8_t*& in, const uint8_t* end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in == end) {
+            throw runtime_error("Поврежденный блок: неожиданный конец данных");
+        }
+        uint8_t byte = *in++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw runtime_error("Поврежденный блок: слишком длинное число");
+}
+
+// Сжатие n значений. Разности соседних значений (по модулю 2^bits) переводятся в zigzag,
+// чтобы малые отрицательные были малыми числами. Повторы одной разности (постоянные
+// и линейные участки) пишутся как (длина, значение), остальное - группами литералов.
+template <typename T>
+void encodeChunk(const T* values, size_t n, vector<uint8_t>& out) {
+    using U = CodecWord<T>;
+    const int bits = int(sizeof(U) * 8);
+    vector<uint64_t> zz(n);
+    U prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        U cur;
+        memcpy(&cur, &values[i], sizeof(U));
+        U d = U(cur - prev);
+        U sign = (d >> (bits - 1)) ? U(~U(0)) : U(0);
+        zz[i] = uint64_t(U(U(d << 1) ^ sign));
+        prev = cur;
+    }
+    size_t literalStart = 0;
+    auto flushLiterals = [&](size_t end) {
+        if (end > literalStart) {
+            putVarint(out, uint64_t(end - literalStart) << 1);
+            for (size_t i = literalStart; i < end; ++i) {
+                putVarint(out, zz[i]);
+            }
+        }
+    };
+    size_t i = 0;
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && zz[i + run] == zz[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            flushLiterals(i);
+            putVarint(out, (uint64_t(run) << 1) | 1);
+            putVarint(out, zz[i]);
+            literalStart = i + run;
+        }
+        i += run;
+    }
+    flushLiterals(n);
+}
+
+template <typename T>
+void decodeChunk(const uint8_t* in, size_t bytes, T* values, size_t n) {
+    using U = CodecWord<T>;
+    const uint8_t* end = in + bytes;
+    U prev = 0;
+    size_t i = 0;
+    auto emit = [&](uint64_t z) {
+        U zu = U(z);
+        U d = U((zu >> 1) ^ U(U(0) - U(zu & 1)));
+        prev = U(prev + d);
+        memcpy(&values[i++], &prev, sizeof(U));
+    };
+    while (i < n) {
+        uint64_t token = getVarint(in, end);
+        uint64_t count = token >> 1;
+        if (count == 0 || count > n - i) {
+            throw runtime_error("Поврежденный блок: неверная длина группы");
+        }
+        if (token & 1) {
+            uint64_t z = getVarint(in, end);
+            for (uint64_t c = 0; c < count; ++c) {
+                emit(z);
+            }
+        }
+        else {
+            for (uint64_t c = 0; c < count; ++c) {
+                emit(getVarint(in, end));
+            }
+        }
+    }
+}
+
+// Запись массива в блочный формат; кубики сжимаются параллельно партиями,
+// чтобы в памяти одновременно было не больше нескольких сжатых кубиков на поток
+template <typename T, typename Layout, typename Allocator>
+void saveChunked(const BasicArray3d<T, Layout, Allocator>& array, const string& path, size_t chunk = 32) {
+    if (chunk == 0) {
+        throw invalid_argument("Размер кубика должен быть больше нуля");
+    }
+    ofstream out(path, ios::binary);
+    if (!out) {
+        throw runtime_error("Не удалось открыть файл: " + path);
+    }
+    size_t dims[3] = { array.size0(), array.size1(), array.size2() };
+    size_t counts[3];
+    for (int a = 0; a < 3; ++a) {
+        counts[a] = (dims[a] + chunk - 1) / chunk;
+    }
+    size_t total = counts[0] * counts[1] * counts[2];
+
+    ChunkedFileHeader header = {};
+    memcpy(header.magic, "A3C1", 4);
+    header.elementCode = elementCode<T>();
+    header.chunk = uint32_t(chunk);
+    for (int a = 0; a < 3; ++a) {
+        header.dims[a] = dims[a];
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header)); // indexOffset допишем в конце
+
+    vector<uint64_t> offsets;
+    offsets.reserve(total + 1);
+    uint64_t position = sizeof(header);
+    size_t batch = workerCount() * 4;
+    vector<vector<uint8_t>> blobs(batch);
+    for (size_t first = 0; first < total; first += batch) {
+        size_t last = min(total, first + batch);
+        parallelFor(last - first, [&](size_t begin, size_t end) {
+            vector<T> cells;
+            for (size_t b = begin; b < end; ++b) {
+                size_t id = first + b;
+                size_t c0 = id / (counts[1] * counts[2]), c1 = id / counts[2] % counts[1], c2 = id % counts[2];
+                size_t i0 = c0 * chunk, j0 = c1 * chunk, k0 = c2 * chunk;
+                size_t e0 = min(chunk, dims[0] - i0), e1 = min(chunk, dims[1] - j0), e2 = min(chunk, dims[2] - k0);
+                cells.resize(e0 * e1 * e2);
+                size_t n = 0;
+                for (size_t i = 0; i < e0; ++i) {
+                    for (size_t j = 0; j < e1; ++j) {
+                        for (size_t k = 0; k < e2; ++k) {
+                            cells[n++] = array.unchecked(i0 + i, j0 + j, k0 + k);
+                        }
+                    }
+                }
+                blobs[b].clear();
+                encodeChunk(cells.data(), cells.size(), blobs[b]);
+            }
+        }, 1);
+        for (size_t b = 0; b < last - first; ++b) {
+            offsets.push_back(position);
+            out.write(reinterpret_cast<const char*>(blobs[b].data()), streamsize(blobs[b].size()));
+            position += blobs[b].size();
+        }
+    }
+    offsets.push_back(position);
+    header.indexOffset = position;
+    out.write(reinterpret_cast<const char*>(offsets.data()), streamsize(offsets.size() * sizeof(uint64_t)));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) {
+        throw runtime_error("Ошибка записи в файл: " + path);
+    }
+}
+
+// Массив в блочном формате, читаемый лениво: в памяти только таблица смещений
+// и ограниченный LRU-кэш распакованных кубиков. Интерфейс чтения - как у Array3d.
+template <typename T>
+class ChunkedArray3d {
+private:
+    using Chunk = shared_ptr<const vector<T>>;
+
+    size_t dims[3] = {};
+    size_t counts[3] = {};
+    size_t chunk = 0;
+    vector<uint64_t> offsets;
+
+    mutable ifstream file;
+    mutable mutex fileLock;  // чтение файла
+    mutable mutex cacheLock; // LRU-кэш
+    size_t capacity;         // сколько кубиков держать распакованными
+    mutable list<size_t> recent; // голова - самый свежий
+    mutable unordered_map<size_t, pair<Chunk, list<size_t>::iterator>> cache;
+
+    size_t chunkId(size_t c0, size_t c1, size_t c2) const { return (c0 * counts[1] + c1) * counts[2] + c2; }
+
+    // Размеры кубика по осям (крайние кубики меньше)
+    size_t extent(int axis, size_t c) const { return min(chunk, dims[axis] - c * chunk); }
+
+    Chunk findCached(size_t id) const {
+        lock_guard<mutex> guard(cacheLock);
+        auto it = cache.find(id);
+        if (it == cache.end()) {
+            return nullptr;
+        }
+        recent.splice(recent.begin(), recent, it->second.second);
+        return it->second.first;
+    }
+
+    void insertCached(size_t id, const Chunk& data) const {
+        lock_guard<mutex> guard(cacheLock);
+        if (cache.count(id) != 0 || capacity == 0) {
+            return;
+        }
+        recent.push_front(id);
+        cache.emplace(id, make_pair(data, recent.begin()));
+        while (cache.size() > capacity) {
+            cache.erase(recent.back()); // вытесненный кубик живет, пока его держит читающий срез
+            recent.pop_back();
+        }
+    }
+
+    Chunk decode(size_t id) const {
+        vector<uint8_t> packed(size_t(offsets[id + 1] - offsets[id]));
+        {
+            lock_guard<mutex> guard(fileLock);
+            file.seekg(streamoff(offsets[id]));
+            file.read(reinterpret_cast<char*>(packed.data()), streamsize(packed.size()));
+            if (!file) {
+                file.clear();
+                throw runtime_error("Не удалось прочитать блок из файла");
+            }
+        }
+        size_t c0 = id / (counts[1] * counts[2]), c1 = id / counts[2] % counts[1], c2 = id % counts[2];
+        auto cells = make_shared<vector<T>>(extent(0, c0) * extent(1, c1) * extent(2, c2));
+        decodeChunk(packed.data(), packed.size(), cells->data(), cells->size());
+        return cells;
+    }
+
+    Chunk load(size_t id) const {
+        Chunk data = findCached(id);
+        if (!data) {
+            data = decode(id);
+            insertCached(id, data);
+        }
+        return data;
+    }
+
+    // Загрузка набора кубиков: недостающие распаковываются параллельно.
+    // Ошибка распаковки в любом потоке пробрасывается вызывающему (см. parallelFor)
+    vector<Chunk> loadMany(const vector<size_t>& ids) const {
+        vector<Chunk> result(ids.size());
+        vector<size_t> missing;
+        for (size_t n = 0; n < ids.size(); ++n) {
+            result[n] = findCached(ids[n]);
+            if (!result[n]) {
+                missing.push_back(n);
+            }
+        }
+        parallelFor(missing.size(), [&](size_t begin, size_t end) {
+            for (size_t m = begin; m < end; ++m) {
+                result[missing[m]] = decode(ids[missing[m]]);
+            }
+        }, 2);
+        for (size_t m : missing) {
+            insertCached(ids[m], result[m]);
+        }
+        return result;
+    }
+
+    void check(size_t index, int axis) const {
+        if (index >= dims[axis]) {
+            throw out_of_range("Индекс выходит за пределы массива");
+        }
+    }
+
+    // Плоский срез: axis - фиксированная ось, остальные две идут по строкам/столбцам
+    vector<vector<T>> plane(int axis, size_t index) const {
+        check(index, axis);
+        int rowAxis = axis == 0 ? 1 : 0;
+        int colAxis = axis == 2 ? 1 : 2;
+        size_t fixedChunk = index / chunk;
+        vector<size_t> ids;
+        for (size_t r = 0; r < counts[rowAxis]; ++r) {
+            for (size_t c = 0; c < counts[colAxis]; ++c) {
+                size_t cc[3];
+                cc[axis] = fixedChunk;
+                cc[rowAxis] = r;
+                cc[colAxis] = c;
+                ids.push_back(chunkId(cc[0], cc[1], cc[2]));
+            }
+        }
+        vector<Chunk> chunks = loadMany(ids);
+        vector<vector<T>> slice(dims[rowAxis], vector<T>(dims[colAxis]));
+        size_t n = 0;
+        for (size_t r = 0; r < counts[rowAxis]; ++r) {
+            for (size_t c = 0; c < counts[colAxis]; ++c) {
+                const vector<T>& cells = *chunks[n++];
+                size_t cc[3];
+                cc[axis] = fixedChunk;
+                cc[rowAxis] = r;
+                cc[colAxis] = c;
+                size_t e[3] = { extent(0, cc[0]), extent(1, cc[1]), extent(2, cc[2]) };
+                size_t local[3];
+                local[axis] = index % chunk;
+                for (local[rowAxis] = 0; local[rowAxis] < e[rowAxis]; ++local[rowAxis]) {
+                    for (local[colAxis] = 0; local[colAxis] < e[colAxis]; ++local[colAxis]) {
+                        slice[r * chunk + local[rowAxis]][c * chunk + local[colAxis]] =
+                            cells[(local[0] * e[1] + local[1]) * e[2] + local[2]];
+                    }
+                }
+            }
+        }
+        return slice;
+    }
+
+    // Линейный срез вдоль оси axis при двух фиксированных индексах
+    vector<vector<T>> line(int axis, size_t a, size_t b) const {
+        int firstAxis = axis == 0 ? 1 : 0;
+        int secondAxis = axis == 2 ? 1 : 2;
+        check(a, firstAxis);
+        check(b, secondAxis);
+        vector<size_t> ids;
+        for (size_t c = 0; c < counts[axis]; ++c) {
+            size_t cc[3];
+            cc[axis] = c;
+            cc[firstAxis] = a / chunk;
+            cc[secondAxis] = b / chunk;
+            ids.push_back(chunkId(cc[0], cc[1], cc[2]));
+        }
+        vector<Chunk> chunks = loadMany(ids);
+        vector<T> values(dims[axis]);
+        for (size_t c = 0; c < counts[axis]; ++c) {
+            size_t cc[3];
+            cc[axis] = c;
+            cc[firstAxis] = a / chunk;
+            cc[secondAxis] = b / chunk;
+            size_t e[3] = { extent(0, cc[0]), extent(1, cc[1]), extent(2, cc[2]) };
+            size_t local[3];
+            local[firstAxis] = a % chunk;
+            local[secondAxis] = b % chunk;
+            for (local[axis] = 0; local[axis] < e[axis]; ++local[axis]) {
+                values[c * chunk + local[axis]] = (*chunks[c])[(local[0] * e[1] + local[1]) * e[2] + local[2]];
+            }
+        }
+        return { values };
+    }
+
+public:
+    // cacheChunks - сколько распакованных кубиков держать в памяти
+    explicit ChunkedArray3d(const string& path, size_t cacheChunks = 256)
+        : file(path, ios::binary), capacity(cacheChunks) {
+        if (!file) {
+            throw runtime_error("Не удалось открыть файл: " + path);
+        }
+        ChunkedFileHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || memcmp(header.magic, "A3C1", 4) != 0) {
+            throw runtime_error("Файл не содержит блочный Array3d: " + path);
+        }
+        if (header.elementCode != elementCode<T>()) {
+            throw runtime_error("Тип элементов в файле не совпадает с массивом: " + path);
+        }
+        if (header.chunk == 0) {
+            throw runtime_error("Поврежденный заголовок: " + path);
+        }
+        chunk = header.chunk;
+        size_t total = 1;
+        for (int a = 0; a < 3; ++a) {
+            dims[a] = size_t(header.dims[a]);
+            counts[a] = (dims[a] + chunk - 1) / chunk;
+            total = checkedMul(total, counts[a]);
+        }
+        offsets.resize(total + 1);
+        file.seekg(streamoff(header.indexOffset));
+        file.read(reinterpret_cast<char*>(offsets.data()), streamsize(offsets.size() * sizeof(uint64_t)));
+        if (!file) {
+            throw runtime_error("Поврежденная таблица блоков: " + path);
+        }
+        for (size_t id = 0; id < total; ++id) {
+            if (offsets[id + 1] < offsets[id] || offsets[id + 1] > header.indexOffset) {
+                throw runtime_error("Поврежденная таблица блоков: " + path);
+            }
+        }
+    }
+
+    size_t size0() const { return dims[0]; }
+    size_t size1() const { return dims[1]; }
+    size_t size2() const { return dims[2]; }
+    size_t size() const { return dims[0] * dims[1] * dims[2]; }
+    size_t chunkSize() const { return chunk; }
+    size_t cachedChunks() const { lock_guard<mutex> guard(cacheLock); return cache.size(); }
+
+    // Чтение одного элемента (распаковывает его кубик, если того нет в кэше)
+    T operator()(size_t i, size_t j, size_t k) const {
+        check(i, 0);
+        check(j, 1);
+        check(k, 2);
+        size_t c0 = i / chunk, c1 = j / chunk, c2 = k / chunk;
+        Chunk cells = load(chunkId(c0, c1, c2));
+        size_t e1 = extent(1, c1), e2 = extent(2, c2);
+        return (*cells)[((i % chunk) * e1 + j % chunk) * e2 + k % chunk];
+    }
+
+    // Срезы - в том же виде, что и у Array3d
+    vector<vector<T>> GetValues0(size_t i) const { return plane(0, i); }
+    vector<vector<T>> GetValues1(size_t j) const { return plane(1, j); }
+    vector<vector<T>> GetValues2(size_t k) const { return plane(2, k); }
+    vector<vector<T>> GetValues01(size_t i, size_t j) const { return line(2, i, j); }
+    vector<vector<T>> GetValues02(size_t i, size_t k) const { return line(1, i, k); }
+    vector<vector<T>> GetValues12(size_t j, size_t k) const { return line(0, j, k); }
+
+    // Полная распаковка в обычный массив (кубики распаковываются параллельно, мимо кэша).
+    // Поврежденный кубик - runtime_error у вызывающего, из какого бы потока он ни читался
+    template <typename Layout = RowMajorLayout>
+    BasicArray3d<T, Layout> load() const {
+        BasicArray3d<T, Layout> result(dims[0], dims[1], dims[2]);
+        size_t total = counts[0] * counts[1] * counts[2];
+        parallelFor(total, [&](size_t begin, size_t end) {
+            for (size_t id = begin; id < end; ++id) {
+                Chunk cells = decode(id);
+                size_t c0 = id / (counts[1] * counts[2]), c1 = id / counts[2] % counts[1], c2 = id % counts[2];
+                size_t e0 = extent(0, c0), e1 = extent(1, c1), e2 = extent(2, c2);
+                size_t n = 0;
+                for (size_t i = 0; i < e0; ++i) {
+                    for (size_t j = 0; j < e1; ++j) {
+                        for (size_t k = 0; k < e2; ++k) {
+                            result.unchecked(c0 * chunk + i, c1 * chunk + j, c2 * chunk + k) = (*cells)[n++];
+                        }
+                    }
+                }
+            }
+        }, 2);
+        return result;
+    }
+};
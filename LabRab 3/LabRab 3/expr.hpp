@@ -0,0 +1,180 @@
+﻿#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+using namespace std;
+
+// Шаблоны выражений для поэлементной арифметики над Array3d.
+// Выражение вида a + b * 2.0 не считается сразу, а строит дерево узлов;
+// при присваивании в массив все операции выполняются за один проход
+// по хранилищу без временных массивов.
+// Операнды должны иметь одинаковые размеры и размещение: тогда индексы
+// их хранилищ совпадают и выражение вычисляется по плоскому индексу.
+
+// Признак узла выражения (лист-массив, скаляр или операция)
+template <typename E>
+struct IsArrayExpr : false_type {};
+
+// Лист: хранилище массива
+template <typename T, typename Layout>
+class ArrayLeaf {
+private:
+    const T* ptr;
+    size_t d0, d1, d2, count;
+
+public:
+    using value_type = T;
+    using layout_type = Layout;
+    static constexpr bool isScalar = false;
+
+    ArrayLeaf(const T* p, size_t s0, size_t s1, size_t s2, size_t n) : ptr(p), d0(s0), d1(s1), d2(s2), count(n) {}
+
+    T at(size_t n) const { return ptr[n]; }
+    size_t size0() const { return d0; }
+    size_t size1() const { return d1; }
+    size_t size2() const { return d2; }
+    size_t storageSize() const { return count; }
+};
+
+// Лист: скаляр, одинаковый для всех ячеек
+template <typename S>
+class ScalarLeaf {
+private:
+    S value;
+
+public:
+    using value_type = S;
+    using layout_type = void;
+    static constexpr bool isScalar = true;
+
+    explicit ScalarLeaf(S v) : value(v) {}
+
+    S at(size_t) const { return value; }
+};
+
+// Поэлементные операции
+struct AddOp { template <typename A, typename B> static auto apply(A a, B b) { return a + b; } };
+struct SubOp { template <typename A, typename B> static auto apply(A a, B b) { return a - b; } };
+struct MulOp { template <typename A, typename B> static auto apply(A a, B b) { return a * b; } };
+struct DivOp { template <typename A, typename B> static auto apply(A a, B b) { return a / b; } };
+
+// Узел бинарной операции
+template <typename Op, typename L, typename R>
+class BinaryExpr {
+    static_assert(L::isScalar || R::isScalar || is_same<typename L::layout_type, typename R::layout_type>::value,
+        "Операнды выражения должны иметь одинаковое размещение");
+
+private:
+    L lhs;
+    R rhs;
+
+    // Размеры берем у нескалярного операнда
+    const auto& shape() const { return shapeOf(integral_constant<bool, L::isScalar>()); }
+    const R& shapeOf(true_type) const { return rhs; }
+    const L& shapeOf(false_type) const { return lhs; }
+
+public:
+    using value_type = decltype(Op::apply(declval<typename L::value_type>(), declval<typename R::value_type>()));
+    using layout_type = conditional_t<L::isScalar, typename R::layout_type, typename L::layout_type>;
+    static constexpr bool isScalar = false;
+
+    BinaryExpr(const L& l, const R& r) : lhs(l), rhs(r) {
+        checkShapes(integral_constant<bool, L::isScalar || R::isScalar>());
+    }
+
+    value_type at(size_t n) const { return Op::apply(lhs.at(n), rhs.at(n)); }
+    size_t size0() const { return shape().size0(); }
+    size_t size1() const { return shape().size1(); }
+    size_t size2() const { return shape().size2(); }
+    size_t storageSize() const { return shape().storageSize(); }
+
+private:
+    void checkShapes(true_type) const {}
+    void checkShapes(false_type) const {
+        if (lhs.size0() != rhs.size0() || lhs.size1() != rhs.size1() || lhs.size2() != rhs.size2()) {
+            throw invalid_argument("Размеры массивов в выражении не совпадают");
+        }
+    }
+};
+
+// Узел унарного минуса
+template <typename E>
+class NegateExpr {
+private:
+    E arg;
+
+public:
+    using value_type = decltype(-declval<typename E::value_type>());
+    using layout_type = typename E::layout_type;
+    static constexpr bool isScalar = false;
+
+    explicit NegateExpr(const E& e) : arg(e) {}
+
+    value_type at(size_t n) const { return -arg.at(n); }
+    size_t size0() const { return arg.size0(); }
+    size_t size1() const { return arg.size1(); }
+    size_t size2() const { return arg.size2(); }
+    size_t storageSize() const { return arg.storageSize(); }
+};
+
+template <typename T, typename Layout>
+struct IsArrayExpr<ArrayLeaf<T, Layout>> : true_type {};
+template <typename Op, typename L, typename R>
+struct IsArrayExpr<BinaryExpr<Op, L, R>> : true_type {};
+template <typename E>
+struct IsArrayExpr<NegateExpr<E>> : true_type {};
+
+// Превращение операнда в узел: массивы специализируют ExprNode в array3d.hpp,
+// узлы выражений остаются как есть, числа становятся скалярными листьями
+template <typename X, typename = void>
+struct ExprNode {};
+
+template <typename X>
+struct ExprNode<X, enable_if_t<IsArrayExpr<X>::value>> {
+    using type = X;
+    static const X& make(const X& x) { return x; }
+};
+
+template <typename X>
+struct ExprNode<X, enable_if_t<is_arithmetic<X>::value>> {
+    using type = ScalarLeaf<X>;
+    static type make(X x) { return type(x); }
+};
+
+// Операнд, который не является просто числом (массив или выражение)
+template <typename X, typename = void>
+struct IsArrayOperand : false_type {};
+template <typename X>
+struct IsArrayOperand<X, enable_if_t<!is_arithmetic<X>::value, void_t<typename ExprNode<X>::type>>> : true_type {};
+
+// Оператор допустим, если хотя бы один операнд - массив, а второй - массив или число
+template <typename X, typename Y>
+using EnableArrayOp = enable_if_t<
+    (IsArrayOperand<X>::value && (IsArrayOperand<Y>::value || is_arithmetic<Y>::value)) ||
+    (is_arithmetic<X>::value && IsArrayOperand<Y>::value)>;
+
+template <typename Op, typename X, typename Y>
+auto makeBinary(const X& x, const Y& y) {
+    using LN = typename ExprNode<X>::type;
+    using RN = typename ExprNode<Y>::type;
+    return BinaryExpr<Op, LN, RN>(ExprNode<X>::make(x), ExprNode<Y>::make(y));
+}
+
+template <typename X, typename Y, typename = EnableArrayOp<X, Y>>
+auto operator+(const X& x, const Y& y) { return makeBinary<AddOp>(x, y); }
+
+template <typename X, typename Y, typename = EnableArrayOp<X, Y>>
+auto operator-(const X& x, const Y& y) { return makeBinary<SubOp>(x, y); }
+
+template <typename X, typename Y, typename = EnableArrayOp<X, Y>>
+auto operator*(const X& x, const Y& y) { return makeBinary<MulOp>(x, y); }
+
+template <typename X, typename Y, typename = EnableArrayOp<X, Y>>
+auto operator/(const X& x, const Y& y) { return makeBinary<DivOp>(x, y); }
+
+template <typename X, typename = enable_if_t<IsArrayOperand<X>::value>>
+auto operator-(const X& x) {
+    using N = typename ExprNode<X>::type;
+    return NegateExpr<N>(ExprNode<X>::make(x));
+}
@@ -0,0 +1,143 @@
+﻿#pragma once
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <cstdint>
+using namespace std;
+
+// Политики размещения элементов Array3d в одномерном хранилище.
+// Смещение ячейки раскладывается на сумму вкладов по каждой оси:
+// offset(i, j, k) = offset0(i) + offset1(j) + offset2(k),
+// поэтому проход вдоль любой оси сводится к одной добавке на шаг.
+
+// Умножение размеров с проверкой переполнения
+inline size_t checkedMul(size_t a, size_t b) {
+    if (a != 0 && b > size_t(-1) / a) {
+        throw overflow_error("Размер массива не помещается в size_t");
+    }
+    return a * b;
+}
+
+// Классическое построчное размещение: i * dim1 * dim2 + j * dim2 + k
+class RowMajorLayout {
+private:
+    size_t stride0 = 0, stride1 = 0;
+    size_t total = 0;
+
+public:
+    static constexpr bool dense = true; // хранилище без выравнивающих ячеек
+    static constexpr const char* name = "row-major";
+    static constexpr uint32_t id = 0; // код размещения в заголовке файла
+
+    void init(size_t d0, size_t d1, size_t d2) {
+        stride1 = d2;
+        stride0 = checkedMul(d1, d2);
+        total = checkedMul(d0, stride0);
+    }
+
+    size_t size() const { return total; }
+
+    size_t offset0(size_t i) const { return i * stride0; }
+    size_t offset1(size_t j) const { return j * stride1; }
+    size_t offset2(size_t k) const { return k; }
+
+    size_t offset(size_t i, size_t j, size_t k) const { return offset0(i) + offset1(j) + offset2(k); }
+};
+
+// Блочное размещение: массив режется на кубики B x B x B,
+// внутри кубика и между кубиками порядок построчный
+template <int B = 8>
+class TiledLayout {
+    static_assert(B > 0 && (B & (B - 1)) == 0, "Размер блока должен быть степенью двойки");
+
+private:
+    static constexpr size_t brick = size_t(B) * B * B;
+    size_t blocks1 = 0, blocks2 = 0;
+    size_t total = 0;
+
+public:
+    static constexpr bool dense = false;
+    static constexpr const char* name = "tiled";
+    static constexpr uint32_t id = 0x100 | B;
+
+    void init(size_t d0, size_t d1, size_t d2) {
+        size_t blocks0 = d0 / B + (d0 % B != 0);
+        blocks1 = d1 / B + (d1 % B != 0);
+        blocks2 = d2 / B + (d2 % B != 0);
+        total = checkedMul(checkedMul(checkedMul(blocks0, blocks1), blocks2), brick);
+    }
+
+    size_t size() const { return total; }
+
+    size_t offset0(size_t i) const { return (i / B) * blocks1 * blocks2 * brick + (i % B) * B * B; }
+    size_t offset1(size_t j) const { return (j / B) * blocks2 * brick + (j % B) * B; }
+    size_t offset2(size_t k) const { return (k / B) * brick + (k % B); }
+
+    size_t offset(size_t i, size_t j, size_t k) const { return offset0(i) + offset1(j) + offset2(k); }
+};
+
+// Z-порядок (кривая Мортона): биты индексов i, j, k чередуются.
+// Каждая ось дополняется до степени двойки отдельно, лишние старшие
+// биты более длинной оси просто идут подряд, поэтому для вытянутых
+// массивов память не раздувается до куба.
+class MortonLayout {
+private:
+    vector<size_t> table0, table1, table2; // вклад каждой оси в смещение
+    size_t total = 0;
+
+    static int bitsFor(size_t d) {
+        int bits = 0;
+        while (bits < 64 && (size_t(1) << bits) < d) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    // Раскладываем биты значения x по позициям, выделенным оси
+    static void buildTable(vector<size_t>& table, size_t d, const vector<int>& positions) {
+        table.assign(d, 0);
+        for (size_t x = 0; x < d; ++x) {
+            size_t code = 0;
+            for (size_t b = 0; b < positions.size(); ++b) {
+                if (x & (size_t(1) << b)) {
+                    code |= size_t(1) << positions[b];
+                }
+            }
+            table[x] = code;
+        }
+    }
+
+public:
+    static constexpr bool dense = false;
+    static constexpr const char* name = "morton";
+    static constexpr uint32_t id = 2;
+
+    void init(size_t d0, size_t d1, size_t d2) {
+        int bits[3] = { bitsFor(d0), bitsFor(d1), bitsFor(d2) };
+        vector<int> positions[3];
+        int next = 0;
+        if (bits[0] + bits[1] + bits[2] >= 64) {
+            throw overflow_error("Размер массива не помещается в size_t");
+        }
+        // младший бит отдаем третьей оси, чтобы соседи по k были рядом
+        for (int level = 0; level < 64; ++level) {
+            for (int axis = 2; axis >= 0; --axis) {
+                if (level < bits[axis]) {
+                    positions[axis].push_back(next++);
+                }
+            }
+        }
+        buildTable(table0, d0, positions[0]);
+        buildTable(table1, d1, positions[1]);
+        buildTable(table2, d2, positions[2]);
+        total = (d0 > 0 && d1 > 0 && d2 > 0) ? size_t(1) << next : 0;
+    }
+
+    size_t size() const { return total; }
+
+    size_t offset0(size_t i) const { return table0[i]; }
+    size_t offset1(size_t j) const { return table1[j]; }
+    size_t offset2(size_t k) const { return table2[k]; }
+
+    size_t offset(size_t i, size_t j, size_t k) const { return table0[i] | table1[j] | table2[k]; }
+};
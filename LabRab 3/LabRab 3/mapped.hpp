@@ -0,0 +1,152 @@
+﻿#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// Режимы отображения файла в память
+enum class MapMode {
+    ReadOnly,    // только чтение (страницы защищены от записи; массив - через ReadOnlyArray)
+    CopyOnWrite, // изменения видны только этому процессу, файл не меняется
+    ReadWrite    // изменения записываются в файл
+};
+
+// Подсказки ОС о характере предстоящего доступа
+enum class MapAdvice { Normal, Sequential, Random, WillNeed };
+
+// Заголовок файла с массивом; данные начинаются с dataOffset (выровнено по странице)
+struct Array3dFileHeader {
+    char magic[4];         // "A3D1"
+    uint32_t elementCode;  // тип элемента, см. elementCode<T>()
+    uint32_t layoutId;     // политика размещения, см. Layout::id
+    uint32_t reserved;
+    uint64_t dims[3];
+    uint64_t dataOffset;
+};
+
+constexpr size_t array3dDataOffset = 4096;
+
+// Код типа элемента: размер, знаковость и признак плавающей точки
+template <typename T>
+constexpr uint32_t elementCode() {
+    return uint32_t(sizeof(T)) | (is_floating_point<T>::value ? 0x100u : 0u) | (is_signed<T>::value ? 0x200u : 0u);
+}
+
+// Файл, отображенный в память целиком (RAII)
+class MappedFile {
+private:
+    char* base = nullptr;
+    size_t length = 0;
+
+public:
+    // createSize > 0: файл создается (или обрезается) до нужного размера и открывается на запись
+    MappedFile(const string& path, MapMode mode, size_t createSize = 0) {
+        bool create = createSize > 0;
+        if (create) {
+            mode = MapMode::ReadWrite;
+        }
+#ifdef _WIN32
+        DWORD access = mode == MapMode::ReadWrite ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+        HANDLE file = CreateFileA(path.c_str(), access, FILE_SHARE_READ, nullptr,
+            create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw runtime_error("Не удалось открыть файл: " + path);
+        }
+        LARGE_INTEGER fileSize;
+        if (create) {
+            fileSize.QuadPart = LONGLONG(createSize);
+            SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN);
+            SetEndOfFile(file);
+        }
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw runtime_error("Не удалось узнать размер файла: " + path);
+        }
+        length = size_t(fileSize.QuadPart);
+        DWORD protect = mode == MapMode::ReadOnly ? PAGE_READONLY : mode == MapMode::CopyOnWrite ? PAGE_WRITECOPY : PAGE_READWRITE;
+        HANDLE mapping = length > 0 ? CreateFileMappingA(file, nullptr, protect, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+        if (mapping == nullptr) {
+            throw runtime_error("Не удалось отобразить файл: " + path);
+        }
+        DWORD view = mode == MapMode::ReadOnly ? FILE_MAP_READ : mode == MapMode::CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_WRITE;
+        base = static_cast<char*>(MapViewOfFile(mapping, view, 0, 0, 0));
+        CloseHandle(mapping); // отображение живет, пока открыт вид
+#else
+        int flags = mode == MapMode::ReadWrite ? O_RDWR : O_RDONLY;
+        int fd = create ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), flags);
+        if (fd < 0) {
+            throw runtime_error("Не удалось открыть файл: " + path);
+        }
+        if (create && ftruncate(fd, off_t(createSize)) != 0) {
+            close(fd);
+            throw runtime_error("Не удалось задать размер файла: " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw runtime_error("Не удалось узнать размер файла: " + path);
+        }
+        length = size_t(info.st_size);
+        int prot = mode == MapMode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+        int share = mode == MapMode::CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+        void* p = length > 0 ? mmap(nullptr, length, prot, share, fd, 0) : MAP_FAILED;
+        close(fd); // отображение держит файл само
+        base = p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+#endif
+        if (base == nullptr) {
+            throw runtime_error("Не удалось отобразить файл: " + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap(base, length);
+#endif
+    }
+
+    char* data() const { return base; }
+    size_t size() const { return length; }
+
+    // Подсказка для диапазона байт [offset, offset + bytes); границы выравниваются по странице
+    void advise(size_t offset, size_t bytes, MapAdvice advice) const {
+#ifdef _WIN32
+        (void)offset; (void)bytes; (void)advice; // в Windows подсказки не используются
+#else
+        static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t first = offset / page * page;
+        size_t last = offset + bytes < length ? offset + bytes : length;
+        if (first >= last) {
+            return;
+        }
+        int flag = advice == MapAdvice::Sequential ? MADV_SEQUENTIAL
+            : advice == MapAdvice::Random ? MADV_RANDOM
+            : advice == MapAdvice::WillNeed ? MADV_WILLNEED : MADV_NORMAL;
+        madvise(base + first, last - first, flag);
+#endif
+    }
+
+    static size_t pageSize() {
+#ifdef _WIN32
+        return 4096;
+#else
+        return size_t(sysconf(_SC_PAGESIZE));
+#endif
+    }
+};
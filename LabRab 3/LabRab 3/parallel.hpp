@@ -0,0 +1,102 @@
+﻿#pragma once
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+using namespace std;
+
+// Заданное вручную число потоков (0 - по числу ядер)
+inline size_t& workerLimit() {
+    static size_t limit = 0;
+    return limit;
+}
+
+// Задать число рабочих потоков (0 - вернуть число ядер); например, чтобы проверить
+// многопоточный путь на машине с одним ядром
+inline void setWorkerCount(size_t n) {
+    workerLimit() = n;
+}
+
+// Число рабочих потоков (hardware_concurrency может вернуть 0)
+inline size_t workerCount() {
+    if (workerLimit() != 0) {
+        return workerLimit();
+    }
+    size_t n = thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Делит диапазон [0, count) на непрерывные куски и обрабатывает их в нескольких потоках.
+// body(begin, end) вызывается для каждого куска; куски меньше grain не дробятся,
+// поэтому маленькие массивы обрабатываются в вызывающем потоке без накладных расходов.
+// Исключение из body в любом потоке не роняет процесс: все потоки дожидаются завершения,
+// затем первое исключение (по порядку кусков) пробрасывается вызывающему
+template <typename F>
+void parallelFor(size_t count, F body, size_t grain = size_t(1) << 15) {
+    size_t threads = min(workerCount(), count / max<size_t>(grain, 1));
+    if (threads <= 1) {
+        body(size_t(0), count);
+        return;
+    }
+    size_t chunk = (count + threads - 1) / threads;
+    vector<exception_ptr> errors(threads); // у каждого куска свое место - запись без блокировок
+    vector<thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        size_t begin = t * chunk;
+        size_t end = min(count, begin + chunk);
+        if (begin >= end) {
+            continue;
+        }
+        auto task = [=, &errors] {
+            try {
+                body(begin, end);
+            }
+            catch (...) {
+                errors[t] = current_exception();
+            }
+        };
+        try {
+            pool.emplace_back(task);
+        }
+        catch (...) {
+            task(); // поток не создался - кусок выполняется в текущем
+        }
+    }
+    try {
+        body(size_t(0), min(count, chunk)); // первый кусок - в текущем потоке
+    }
+    catch (...) {
+        errors[0] = current_exception();
+    }
+    for (auto& worker : pool) {
+        worker.join();
+    }
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+// Параллельная свертка: каждый кусок сворачивается в свое значение, затем они объединяются
+template <typename R, typename F, typename Combine>
+R parallelReduce(size_t count, R init, F body, Combine combine, size_t grain = size_t(1) << 15) {
+    size_t threads = max<size_t>(1, min(workerCount(), count / max<size_t>(grain, 1)));
+    size_t chunk = (count + threads - 1) / threads;
+    vector<R> partial(threads, init);
+    parallelFor(threads, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            size_t begin = t * chunk;
+            size_t end = min(count, begin + chunk);
+            if (begin < end) {
+                partial[t] = body(begin, end, init);
+            }
+        }
+    }, 1);
+    R result = init;
+    for (const R& value : partial) {
+        result = combine(result, value);
+    }
+    return result;
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+using namespace std;
+
+// Перестановка осей плотного (построчного) трехмерного блока памяти.
+// Результат: ось n результата - это ось axes[n] исходного массива,
+// out(x0, x1, x2) = in(...), где индекс по оси axes[n] равен xn.
+
+// Проверка, что axes - перестановка {0, 1, 2}
+inline void checkAxes(const array<int, 3>& axes) {
+    array<int, 3> sorted = axes;
+    sort(sorted.begin(), sorted.end());
+    if (sorted[0] != 0 || sorted[1] != 1 || sorted[2] != 2) {
+        throw invalid_argument("axes должен быть перестановкой осей 0, 1, 2");
+    }
+}
+
+// Кэш-независимая рекурсия: делим самую длинную сторону пополам, пока блок
+// не станет маленьким (помещается в L1 вместе с источником), и тогда копируем.
+// На каждом уровне рекурсии оба массива читаются и пишутся компактными кусками,
+// поэтому алгоритм хорошо работает при любом размере кэша без подбора параметров.
+// src уже смещен на начало блока; srcStride[n] - шаг источника вдоль оси n результата.
+template <typename T>
+void permuteBlock(const T* src, T* dst, const array<ptrdiff_t, 3>& srcStride, const array<size_t, 3>& dstStride,
+    array<size_t, 3> from, array<size_t, 3> to) {
+    const size_t leaf = 512;
+    size_t ext[3] = { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+    if (ext[0] * ext[1] * ext[2] > leaf) {
+        int longest = ext[0] >= ext[1] && ext[0] >= ext[2] ? 0 : ext[1] >= ext[2] ? 1 : 2;
+        size_t middle = from[longest] + ext[longest] / 2;
+        array<size_t, 3> firstTo = to, secondFrom = from;
+        firstTo[longest] = middle;
+        secondFrom[longest] = middle;
+        permuteBlock(src, dst, srcStride, dstStride, from, firstTo);
+        permuteBlock(src, dst, srcStride, dstStride, secondFrom, to);
+        return;
+    }
+    // Лист. Если внутренняя ось результата в источнике тоже непрерывна - простое копирование,
+    // иначе маленькая транспозиция: блок целиком в L1, порядок обхода не важен
+    for (size_t x0 = from[0]; x0 < to[0]; ++x0) {
+        for (size_t x1 = from[1]; x1 < to[1]; ++x1) {
+            const T* s = src + ptrdiff_t(x0) * srcStride[0] + ptrdiff_t(x1) * srcStride[1];
+            T* d = dst + x0 * dstStride[0] + x1 * dstStride[1];
+            const ptrdiff_t step = srcStride[2];
+            for (size_t x2 = from[2]; x2 < to[2]; ++x2) {
+                d[x2] = s[ptrdiff_t(x2) * step];
+            }
+        }
+    }
+}
@@ -0,0 +1,364 @@
+﻿#pragma once
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+#include "array3d.hpp"
+using namespace std;
+
+// Разреженный трехмерный массив для объемов, где почти все ячейки равны фону.
+// Массив делится на кубики B x B x B; в памяти хранятся только кубики, в которые
+// что-то записали, остальные целиком считаются фоновыми. Память растет с объемом
+// данных, а не с размером ограничивающего параллелепипеда.
+template <typename T = double, size_t B = 8>
+class SparseArray3d {
+    static_assert(is_arithmetic<T>::value, "SparseArray3d хранит только арифметические типы");
+    static_assert(B > 0 && (B & (B - 1)) == 0, "Размер блока должен быть степенью двойки");
+
+private:
+    static constexpr size_t brickCells = B * B * B;
+
+    size_t dim0, dim1, dim2;       // Размеры массива
+    size_t blocks1, blocks2;       // Число кубиков по второй и третьей осям
+    T background;                  // Значение всех ячеек вне хранимых кубиков
+    unordered_map<uint64_t, vector<T>> bricks; // номер кубика -> его ячейки (построчно)
+
+    uint64_t brickId(size_t i, size_t j, size_t k) const {
+        return (uint64_t(i / B) * blocks1 + j / B) * blocks2 + k / B;
+    }
+
+    static size_t cellIndex(size_t i, size_t j, size_t k) {
+        return ((i % B) * B + j % B) * B + k % B;
+    }
+
+    void check(size_t i, size_t j, size_t k) const {
+        if (i >= dim0 || j >= dim1 || k >= dim2) {
+            throw out_of_range("Индексы выходят за пределы массива");
+        }
+    }
+
+    // Кубик для записи: создается заполненным фоном
+    vector<T>& brickFor(size_t i, size_t j, size_t k) {
+        auto it = bricks.find(brickId(i, j, k));
+        if (it == bricks.end()) {
+            it = bricks.emplace(brickId(i, j, k), vector<T>(brickCells, background)).first;
+        }
+        return it->second;
+    }
+
+    // Координаты начала кубика по его номеру
+    void brickOrigin(uint64_t id, size_t& i0, size_t& j0, size_t& k0) const {
+        k0 = size_t(id % blocks2) * B;
+        j0 = size_t(id / blocks2 % blocks1) * B;
+        i0 = size_t(id / blocks2 / blocks1) * B;
+    }
+
+public:
+    // Итератор по всем ячейкам в логическом порядке (только чтение)
+    class const_iterator {
+    private:
+        const SparseArray3d* owner;
+        size_t i, j, k;
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator(const SparseArray3d* o, size_t i0) : owner(o), i(i0), j(0), k(0) {}
+
+        const T& operator*() const { return owner->unchecked(i, j, k); }
+        const_iterator& operator++() {
+            if (++k == owner->dim2) {
+                k = 0;
+                if (++j == owner->dim1) {
+                    j = 0;
+                    ++i;
+                }
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++(*this); return tmp; }
+        bool operator==(const const_iterator& other) const { return i == other.i && j == other.j && k == other.k; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+
+    SparseArray3d(size_t d0, size_t d1, size_t d2, T fon = T(0))
+        : dim0(d0), dim1(d1), dim2(d2), blocks1((d1 + B - 1) / B), blocks2((d2 + B - 1) / B), background(fon) {
+        checkedMul(checkedMul(d0, d1), d2);
+    }
+
+    // Чтение ячейки: фон, если кубика нет
+    const T& operator()(size_t i, size_t j, size_t k) const {
+        check(i, j, k);
+        return unchecked(i, j, k);
+    }
+
+    // Ссылка на ячейку для записи: чтение не создает кубик, запись идет через set()
+    class Reference {
+    private:
+        SparseArray3d* owner;
+        size_t i, j, k;
+
+    public:
+        Reference(SparseArray3d* o, size_t i0, size_t j0, size_t k0) : owner(o), i(i0), j(j0), k(k0) {}
+
+        operator T() const { return owner->unchecked(i, j, k); }
+        Reference& operator=(T value) { owner->set(i, j, k, value); return *this; }
+        Reference& operator=(const Reference& other) { return *this = T(other); }
+        Reference& operator+=(T value) { return *this = T(*this) + value; }
+        Reference& operator-=(T value) { return *this = T(*this) - value; }
+        Reference& operator*=(T value) { return *this = T(*this) * value; }
+        Reference& operator/=(T value) { return *this = T(*this) / value; }
+    };
+
+    Reference operator()(size_t i, size_t j, size_t k) {
+        check(i, j, k);
+        return Reference(this, i, j, k);
+    }
+
+    const T& unchecked(size_t i, size_t j, size_t k) const {
+        auto it = bricks.find(brickId(i, j, k));
+        return it == bricks.end() ? background : it->second[cellIndex(i, j, k)];
+    }
+
+    // Запись значения; фон в отсутствующий кубик не записывается
+    void set(size_t i, size_t j, size_t k, T value) {
+        check(i, j, k);
+        if (value == background && bricks.find(brickId(i, j, k)) == bricks.end()) {
+            return;
+        }
+        brickFor(i, j, k)[cellIndex(i, j, k)] = value;
+    }
+
+    size_t size0() const { return dim0; }
+    size_t size1() const { return dim1; }
+    size_t size2() const { return dim2; }
+    size_t size() const { return dim0 * dim1 * dim2; }
+    T backgroundValue() const { return background; }
+    size_t storedBricks() const { return bricks.size(); }
+
+    // Примерный объем памяти под данные (без учета накладных расходов хеш-таблицы)
+    size_t memoryBytes() const { return bricks.size() * (brickCells * sizeof(T) + sizeof(uint64_t)); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, dim0); }
+
+    // Обход только нефоновых ячеек: f(i, j, k, value)
+    template <typename F>
+    void forEachActive(F f) const {
+        for (const auto& entry : bricks) {
+            size_t i0, j0, k0;
+            brickOrigin(entry.first, i0, j0, k0);
+            const vector<T>& cells = entry.second;
+            for (size_t n = 0; n < brickCells; ++n) {
+                size_t i = i0 + n / (B * B), j = j0 + n / B % B, k = k0 + n % B;
+                if (cells[n] != background && i < dim0 && j < dim1 && k < dim2) {
+                    f(i, j, k, cells[n]);
+                }
+            }
+        }
+    }
+
+    // Удаление кубиков, в которых остался только фон
+    void compact() {
+        for (auto it = bricks.begin(); it != bricks.end();) {
+            bool empty = all_of(it->second.begin(), it->second.end(), [&](T v) { return v == background; });
+            it = empty ? bricks.erase(it) : next(it);
+        }
+    }
+
+    // Заполнение целиком - просто смена фона, память освобождается
+    void fill(T value) {
+        bricks.clear();
+        background = value;
+    }
+
+    void zeros() { fill(T(0)); }
+    void ones() { fill(T(1)); }
+
+    // Срезы - в том же виде, что и у Array3d
+    vector<vector<T>> GetValues0(size_t i) const {
+        check(i, 0, 0);
+        vector<vector<T>> slice(dim1, vector<T>(dim2));
+        for (size_t j = 0; j < dim1; ++j) {
+            for (size_t k = 0; k < dim2; ++k) {
+                slice[j][k] = unchecked(i, j, k);
+            }
+        }
+        return slice;
+    }
+
+    vector<vector<T>> GetValues1(size_t j) const {
+        check(0, j, 0);
+        vector<vector<T>> slice(dim0, vector<T>(dim2));
+        for (size_t i = 0; i < dim0; ++i) {
+            for (size_t k = 0; k < dim2; ++k) {
+                slice[i][k] = unchecked(i, j, k);
+            }
+        }
+        return slice;
+    }
+
+    vector<vector<T>> GetValues2(size_t k) const {
+        check(0, 0, k);
+        vector<vector<T>> slice(dim0, vector<T>(dim1));
+        for (size_t i = 0; i < dim0; ++i) {
+            for (size_t j = 0; j < dim1; ++j) {
+                slice[i][j] = unchecked(i, j, k);
+            }
+        }
+        return slice;
+    }
+
+    vector<vector<T>> GetValues01(size_t i, size_t j) const {
+        check(i, j, 0);
+        vector<T> line(dim2);
+        for (size_t k = 0; k < dim2; ++k) {
+            line[k] = unchecked(i, j, k);
+        }
+        return { line };
+    }
+
+    vector<vector<T>> GetValues02(size_t i, size_t k) const {
+        check(i, 0, k);
+        vector<T> line(dim1);
+        for (size_t j = 0; j < dim1; ++j) {
+            line[j] = unchecked(i, j, k);
+        }
+        return { line };
+    }
+
+    vector<vector<T>> GetValues12(size_t j, size_t k) const {
+        check(0, j, k);
+        vector<T> line(dim0);
+        for (size_t i = 0; i < dim0; ++i) {
+            line[i] = unchecked(i, j, k);
+        }
+        return { line };
+    }
+
+    void SetValues0(size_t i, const vector<vector<T>>& values) {
+        check(i, 0, 0);
+        for (size_t j = 0; j < dim1; ++j) {
+            for (size_t k = 0; k < dim2; ++k) {
+                set(i, j, k, values[j][k]);
+            }
+        }
+    }
+
+    void SetValues1(size_t j, const vector<vector<T>>& values) {
+        check(0, j, 0);
+        for (size_t i = 0; i < dim0; ++i) {
+            for (size_t k = 0; k < dim2; ++k) {
+                set(i, j, k, values[i][k]);
+            }
+        }
+    }
+
+    void SetValues2(size_t k, const vector<vector<T>>& values) {
+        check(0, 0, k);
+        for (size_t i = 0; i < dim0; ++i) {
+            for (size_t j = 0; j < dim1; ++j) {
+                set(i, j, k, values[i][j]);
+            }
+        }
+    }
+
+    void SetValues01(size_t i, size_t j, const vector<T>& values) {
+        check(i, j, 0);
+        for (size_t k = 0; k < dim2; ++k) {
+            set(i, j, k, values[k]);
+        }
+    }
+
+    void SetValues02(size_t i, size_t k, const vector<T>& values) {
+        check(i, 0, k);
+        for (size_t j = 0; j < dim1; ++j) {
+            set(i, j, k, values[j]);
+        }
+    }
+
+    void SetValues12(size_t j, size_t k, const vector<T>& values) {
+        check(0, j, k);
+        for (size_t i = 0; i < dim0; ++i) {
+            set(i, j, k, values[i]);
+        }
+    }
+
+    // Плотная копия: хранилище заполняется фоном параллельно, затем кубики
+    // раскладываются по потокам (разные кубики не пересекаются)
+    template <typename Layout = RowMajorLayout>
+    BasicArray3d<T, Layout> toDense() const {
+        BasicArray3d<T, Layout> dense(dim0, dim1, dim2);
+        T* p = dense.storage();
+        T fon = background;
+        parallelFor(dense.storageSize(), [&](size_t begin, size_t end) {
+            std::fill(p + begin, p + end, fon);
+        });
+        vector<const pair<const uint64_t, vector<T>>*> list;
+        list.reserve(bricks.size());
+        for (const auto& entry : bricks) {
+            list.push_back(&entry);
+        }
+        parallelFor(list.size(), [&](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; ++n) {
+                size_t i0, j0, k0;
+                brickOrigin(list[n]->first, i0, j0, k0);
+                const vector<T>& cells = list[n]->second;
+                for (size_t i = i0; i < std::min(dim0, i0 + B); ++i) {
+                    for (size_t j = j0; j < std::min(dim1, j0 + B); ++j) {
+                        for (size_t k = k0; k < std::min(dim2, k0 + B); ++k) {
+                            dense.unchecked(i, j, k) = cells[cellIndex(i, j, k)];
+                        }
+                    }
+                }
+            }
+        }, 64);
+        return dense;
+    }
+
+    // Разреженная копия плотного массива: потоки просматривают свои диапазоны кубиков
+    // и собирают те, где есть нефоновые ячейки; вставка в таблицу - в конце, одним потоком
+    template <typename Layout, typename Allocator>
+    static SparseArray3d fromDense(const BasicArray3d<T, Layout, Allocator>& dense, T fon = T(0)) {
+        SparseArray3d result(dense.size0(), dense.size1(), dense.size2(), fon);
+        size_t blocks0 = (result.dim0 + B - 1) / B;
+        size_t total = blocks0 * result.blocks1 * result.blocks2;
+        size_t workers = std::max<size_t>(1, std::min(workerCount(), total));
+        vector<vector<pair<uint64_t, vector<T>>>> found(workers);
+        size_t chunk = (total + workers - 1) / workers;
+        parallelFor(workers, [&](size_t first, size_t last) {
+            for (size_t w = first; w < last; ++w) {
+                vector<T> cells(brickCells);
+                for (uint64_t id = w * chunk; id < std::min(total, (w + 1) * chunk); ++id) {
+                    size_t i0, j0, k0;
+                    result.brickOrigin(id, i0, j0, k0);
+                    bool active = false;
+                    std::fill(cells.begin(), cells.end(), fon);
+                    for (size_t i = i0; i < std::min(result.dim0, i0 + B); ++i) {
+                        for (size_t j = j0; j < std::min(result.dim1, j0 + B); ++j) {
+                            for (size_t k = k0; k < std::min(result.dim2, k0 + B); ++k) {
+                                T v = dense.unchecked(i, j, k);
+                                cells[cellIndex(i, j, k)] = v;
+                                active = active || v != fon;
+                            }
+                        }
+                    }
+                    if (active) {
+                        found[w].emplace_back(id, cells);
+                    }
+                }
+            }
+        }, 1);
+        for (auto& part : found) {
+            for (auto& entry : part) {
+                result.bricks.emplace(entry.first, move(entry.second));
+            }
+        }
+        return result;
+    }
+};
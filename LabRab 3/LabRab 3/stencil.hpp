@@ -0,0 +1,281 @@
+﻿#pragma once
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "array3d.hpp"
+using namespace std;
+
+// Шаблонные (стенсильные) вычисления над Array3d: каждая ячейка результата -
+// взвешенная сумма соседей исходного массива. Шаблон задается на этапе компиляции
+// набором точек (смещение + вес), поэтому цикл по точкам раскручивается компилятором.
+// Массив обходится плитками (блоки по i и j), плитки раздаются потокам,
+// внутренний цикл идет по непрерывной строке k и векторизуется.
+
+// Точка шаблона: смещение относительно центральной ячейки и вес
+struct StencilPoint {
+    int di, dj, dk;
+    double weight;
+};
+
+// 7-точечный лапласиан (центр и 6 соседей по граням)
+struct Laplacian7 {
+    static constexpr array<StencilPoint, 7> points = { {
+        { 0, 0, 0, -6.0 },
+        { -1, 0, 0, 1.0 }, { 1, 0, 0, 1.0 },
+        { 0, -1, 0, 1.0 }, { 0, 1, 0, 1.0 },
+        { 0, 0, -1, 1.0 }, { 0, 0, 1, 1.0 },
+    } };
+};
+
+// Шаблон 3x3x3, где вес зависит только от того, сколько координат смещения не равны нулю
+constexpr array<StencilPoint, 27> cubeStencil(double center, double face, double edge, double corner) {
+    array<StencilPoint, 27> result = {};
+    size_t n = 0;
+    for (int di = -1; di <= 1; ++di) {
+        for (int dj = -1; dj <= 1; ++dj) {
+            for (int dk = -1; dk <= 1; ++dk) {
+                int far = (di != 0) + (dj != 0) + (dk != 0);
+                double w = far == 0 ? center : far == 1 ? face : far == 2 ? edge : corner;
+                result[n++] = { di, dj, dk, w };
+            }
+        }
+    }
+    return result;
+}
+
+// 27-точечный лапласиан: центр -14/3, грани 1/3, ребра 1/6, вершины 1/12 (сумма весов 0)
+struct Laplacian27 {
+    static constexpr array<StencilPoint, 27> points = cubeStencil(-14.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0, 1.0 / 12.0);
+};
+
+// Граничные условия: куда смотреть, если сосед вышел за пределы массива.
+// map() переводит координату в допустимую или возвращает false (значение - ноль)
+struct ClampBoundary {
+    static bool map(ptrdiff_t& x, size_t n) {
+        x = x < 0 ? 0 : x >= ptrdiff_t(n) ? ptrdiff_t(n) - 1 : x;
+        return true;
+    }
+};
+
+struct WrapBoundary {
+    static bool map(ptrdiff_t& x, size_t n) {
+        x %= ptrdiff_t(n);
+        if (x < 0) {
+            x += ptrdiff_t(n);
+        }
+        return true;
+    }
+};
+
+struct ZeroBoundary {
+    static bool map(ptrdiff_t& x, size_t n) {
+        return x >= 0 && x < ptrdiff_t(n);
+    }
+};
+
+// Радиус шаблона по каждой оси
+template <typename Points>
+array<size_t, 3> stencilRadius(const Points& points) {
+    array<size_t, 3> r = { 0, 0, 0 };
+    for (const StencilPoint& p : points) {
+        r[0] = max(r[0], size_t(p.di < 0 ? -p.di : p.di));
+        r[1] = max(r[1], size_t(p.dj < 0 ? -p.dj : p.dj));
+        r[2] = max(r[2], size_t(p.dk < 0 ? -p.dk : p.dk));
+    }
+    return r;
+}
+
+// Строка внутренней области для шаблона, известного при компиляции: для каждой ячейки
+// все точки складываются сразу (сумма раскручена, веса - константы), результат пишется
+// прямо в строку out без промежуточного буфера
+template <typename Stencil, typename T, typename Acc, size_t... P>
+void fusedRow(const T* const* src, const T* center, T* __restrict dst, size_t count, Acc a, Acc b, index_sequence<P...>) {
+    if (b == Acc(0)) { // обычный случай out = alpha * S(in): центр второй раз не читается
+        for (size_t n = 0; n < count; ++n) {
+            dst[n] = T(a * (... + (Acc(Stencil::points[P].weight) * Acc(src[P][n]))));
+        }
+        return;
+    }
+    for (size_t n = 0; n < count; ++n) {
+        Acc acc = (... + (Acc(Stencil::points[P].weight) * Acc(src[P][n])));
+        dst[n] = T(a * acc + b * Acc(center[n]));
+    }
+}
+
+// Один проход шаблона: out = alpha * S(in) + beta * in.
+// Points - массив точек фиксированного размера (шаблон) или vector (свертка).
+// Stencil - тип шаблона с constexpr points: тогда внутренняя область считается fusedRow;
+// для точек, известных только при выполнении (void), строка копится в буфере по точке за проход
+template <typename Boundary, typename Stencil = void, typename Points, typename T, typename Layout, typename Allocator>
+void stencilPass(const BasicArray3d<T, Layout, Allocator>& in, BasicArray3d<T, Layout, Allocator>& out,
+    const Points& points, double alpha = 1.0, double beta = 0.0) {
+    if (&in == &out) {
+        throw invalid_argument("Шаблон нельзя применять на месте: нужен второй буфер");
+    }
+    if (in.size0() != out.size0() || in.size1() != out.size1() || in.size2() != out.size2()) {
+        throw invalid_argument("Размеры массивов не совпадают");
+    }
+    using Acc = conditional_t<is_floating_point<T>::value, T, double>;
+    const size_t d0 = in.size0(), d1 = in.size1(), d2 = in.size2();
+    if (d0 == 0 || d1 == 0 || d2 == 0) {
+        return;
+    }
+    const array<size_t, 3> r = stencilRadius(points);
+    const Acc a = Acc(alpha), b = Acc(beta);
+
+    // Медленный путь: ячейка у границы, координаты соседей проходят через Boundary
+    auto border = [&](size_t i, size_t j, size_t k) {
+        Acc acc = 0;
+        for (const StencilPoint& p : points) {
+            ptrdiff_t x = ptrdiff_t(i) + p.di, y = ptrdiff_t(j) + p.dj, z = ptrdiff_t(k) + p.dk;
+            if (Boundary::map(x, d0) && Boundary::map(y, d1) && Boundary::map(z, d2)) {
+                acc += Acc(p.weight) * Acc(in.unchecked(size_t(x), size_t(y), size_t(z)));
+            }
+        }
+        out.unchecked(i, j, k) = T(a * acc + b * Acc(in.unchecked(i, j, k)));
+    };
+
+    // Шаблон известен при компиляции: через fusedRow идут все строки, включая строки у
+    // границ по i и j - соседние строки переводятся через Boundary один раз на строку,
+    // строка за границей (ZeroBoundary) заменяется строкой нулей
+    constexpr bool fused = !is_void<Stencil>::value;
+    const vector<T> zeroRow(fused ? d2 : 0, T(0));
+    auto fusedLine = [&](size_t i, size_t j) {
+        if constexpr (fused) {
+            constexpr size_t N = tuple_size<decltype(Stencil::points)>::value;
+            array<const T*, N> src;
+            for (size_t p = 0; p < N; ++p) {
+                const StencilPoint& q = Stencil::points[p];
+                ptrdiff_t x = ptrdiff_t(i) + q.di, y = ptrdiff_t(j) + q.dj;
+                src[p] = Boundary::map(x, d0) && Boundary::map(y, d1)
+                    ? &in.unchecked(size_t(x), size_t(y), size_t(ptrdiff_t(r[2]) + q.dk))
+                    : zeroRow.data() + (ptrdiff_t(r[2]) + q.dk);
+            }
+            fusedRow<Stencil>(src.data(), &in.unchecked(i, j, r[2]), &out.unchecked(i, j, r[2]), d2 - 2 * r[2], a, b, make_index_sequence<N>());
+        }
+    };
+
+    // Быстрый путь для строки целиком внутри массива, когда точки известны только при
+    // выполнении: строка копится в буфере, по одной точке шаблона за проход - каждый проход
+    // это простой векторизуемый цикл
+    auto interiorRow = [&](size_t i, size_t j, vector<Acc>& acc) {
+        const size_t count = d2 - 2 * r[2];
+        const T* center = &in.unchecked(i, j, r[2]);
+        for (size_t n = 0; n < count; ++n) {
+            acc[n] = 0;
+        }
+        for (const StencilPoint& p : points) {
+            const T* src = &in.unchecked(size_t(ptrdiff_t(i) + p.di), size_t(ptrdiff_t(j) + p.dj), size_t(ptrdiff_t(r[2]) + p.dk));
+            const Acc w = Acc(p.weight);
+            for (size_t n = 0; n < count; ++n) {
+                acc[n] += w * Acc(src[n]);
+            }
+        }
+        T* dst = &out.unchecked(i, j, r[2]);
+        for (size_t n = 0; n < count; ++n) {
+            dst[n] = T(a * acc[n] + b * Acc(center[n]));
+        }
+    };
+
+    // Плитки: 8 плоскостей i на полосу строк j, чтобы соседние плоскости оставались в кэше
+    const size_t tileI = 8;
+    const size_t rowBytes = d2 * sizeof(T);
+    const size_t tileJ = max<size_t>(1, (size_t(1) << 20) / max<size_t>(1, (tileI + 2 * r[0]) * rowBytes));
+    const size_t tilesI = (d0 + tileI - 1) / tileI, tilesJ = (d1 + tileJ - 1) / tileJ;
+    const bool fast = Layout::dense && d2 > 2 * r[2];
+    parallelFor(tilesI * tilesJ, [&](size_t begin, size_t end) {
+        vector<Acc> acc(is_void<Stencil>::value ? d2 : 0); // буфер строки - свой у каждого потока
+        for (size_t t = begin; t < end; ++t) {
+            size_t i0 = t / tilesJ * tileI, j0 = t % tilesJ * tileJ;
+            size_t i1 = min(d0, i0 + tileI), j1 = min(d1, j0 + tileJ);
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    bool inside = fast && (fused || (i >= r[0] && i + r[0] < d0 && j >= r[1] && j + r[1] < d1));
+                    if (!inside) {
+                        for (size_t k = 0; k < d2; ++k) {
+                            border(i, j, k);
+                        }
+                        continue;
+                    }
+                    if (fused) {
+                        fusedLine(i, j);
+                    }
+                    else {
+                        interiorRow(i, j, acc);
+                    }
+                    for (size_t k = 0; k < r[2]; ++k) {
+                        border(i, j, k);
+                        border(i, j, d2 - 1 - k);
+                    }
+                }
+            }
+        }
+    }, max<size_t>(1, (size_t(1) << 15) / max<size_t>(1, tileI * tileJ * d2)));
+}
+
+// Применение шаблона Stencil: out = alpha * S(in) + beta * in
+template <typename Stencil, typename Boundary = ClampBoundary, typename T, typename Layout, typename Allocator>
+void applyStencil(const BasicArray3d<T, Layout, Allocator>& in, BasicArray3d<T, Layout, Allocator>& out,
+    double alpha = 1.0, double beta = 0.0) {
+    stencilPass<Boundary, Stencil>(in, out, Stencil::points, alpha, beta);
+}
+
+// Многошаговый расчет с двумя буферами: второй буфер выделяется один раз,
+// на каждом шаге буферы меняются ролями; результат остается в a.
+// Например, явная схема для уравнения теплопроводности: alpha = dt, beta = 1
+template <typename Stencil, typename Boundary = ClampBoundary, typename T, typename Layout, typename Allocator>
+void iterateStencil(BasicArray3d<T, Layout, Allocator>& a, size_t steps, double alpha = 1.0, double beta = 0.0) {
+    BasicArray3d<T, Layout, Allocator> scratch(a.size0(), a.size1(), a.size2());
+    BasicArray3d<T, Layout, Allocator>* src = &a;
+    BasicArray3d<T, Layout, Allocator>* dst = &scratch;
+    for (size_t step = 0; step < steps; ++step) {
+        stencilPass<Boundary, Stencil>(*src, *dst, Stencil::points, alpha, beta);
+        swap(src, dst);
+    }
+    if (src != &a) {
+        // нечетное число шагов: копируем в исходное хранилище (оно может быть файлом)
+        copy_n(src->storage(), src->storageSize(), a.storage());
+    }
+}
+
+// Свертка вдоль одной оси с ядром нечетной длины (центр - в середине)
+template <typename Boundary = ClampBoundary, typename T, typename Layout, typename Allocator>
+void convolveAxis(const BasicArray3d<T, Layout, Allocator>& in, BasicArray3d<T, Layout, Allocator>& out,
+    int axis, const vector<double>& kernel) {
+    if (kernel.size() % 2 == 0 || axis < 0 || axis > 2) {
+        throw invalid_argument("Ядро должно иметь нечетную длину, ось - 0, 1 или 2");
+    }
+    int radius = int(kernel.size() / 2);
+    vector<StencilPoint> points;
+    for (int m = -radius; m <= radius; ++m) {
+        points.push_back({ axis == 0 ? m : 0, axis == 1 ? m : 0, axis == 2 ? m : 0, kernel[size_t(m + radius)] });
+    }
+    stencilPass<Boundary>(in, out, points);
+}
+
+// Сепарабельное гауссово размытие: три прохода по осям вместо одного кубического ядра
+template <typename Boundary = ClampBoundary, typename T, typename Layout, typename Allocator>
+void gaussianBlur(BasicArray3d<T, Layout, Allocator>& a, double sigma) {
+    if (sigma <= 0) {
+        throw invalid_argument("sigma должна быть положительной");
+    }
+    int radius = max(1, int(ceil(3 * sigma)));
+    vector<double> kernel(size_t(2 * radius + 1));
+    double total = 0;
+    for (int m = -radius; m <= radius; ++m) {
+        kernel[size_t(m + radius)] = exp(-0.5 * m * m / (sigma * sigma));
+        total += kernel[size_t(m + radius)];
+    }
+    for (double& w : kernel) {
+        w /= total;
+    }
+    BasicArray3d<T, Layout, Allocator> scratch(a.size0(), a.size1(), a.size2());
+    convolveAxis<Boundary>(a, scratch, 0, kernel);
+    convolveAxis<Boundary>(scratch, a, 1, kernel);
+    convolveAxis<Boundary>(a, scratch, 2, kernel);
+    copy_n(scratch.storage(), scratch.storageSize(), a.storage());
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <stdexcept>
+using namespace std;
+
+// Быстрый текстовый вывод чисел: to_chars в буфер вместо потокового форматирования.
+// Строки накапливаются в string и уходят в поток одним write.
+
+// Дописывает значение и пробел в конец строки (дробные - с заданным числом знаков)
+template <typename T>
+void appendValue(string& out, T value, int precision) {
+    char buf[64];
+    to_chars_result res;
+    if constexpr (is_floating_point<T>::value) {
+        res = to_chars(buf, buf + sizeof(buf), value, chars_format::fixed, precision);
+        if (res.ec != errc()) { // огромные числа в fixed не помещаются
+            res = to_chars(buf, buf + sizeof(buf), value, chars_format::scientific, precision);
+        }
+    } else {
+        res = to_chars(buf, buf + sizeof(buf), value); // uint8_t печатается числом
+    }
+    if (res.ec != errc()) {
+        throw runtime_error("Не удалось отформатировать значение");
+    }
+    out.append(buf, res.ptr);
+    out.push_back(' ');
+}
+
+// Строка значений в формате print(): через пробел, в конце перевод строки
+template <typename T>
+void appendLine(string& out, const vector<T>& line, int precision) {
+    for (T value : line) {
+        appendValue(out, value, precision);
+    }
+    out.push_back('\n');
+}
+
+// Вывод одномерного среза (результат GetValues01/02/12 или отдельная строка)
+template <typename T>
+void exportText(ostream& os, const vector<T>& line, int precision = 2) {
+    string out;
+    out.reserve(line.size() * 8);
+    appendLine(out, line, precision);
+    os.write(out.data(), streamsize(out.size()));
+}
+
+// Вывод двумерного среза (результат GetValues0/1/2); буфер сбрасывается примерно по мегабайту
+template <typename T>
+void exportText(ostream& os, const vector<vector<T>>& slice, int precision = 2) {
+    const size_t flushAt = size_t(1) << 20;
+    string out;
+    out.reserve(flushAt + 4096);
+    for (const auto& line : slice) {
+        appendLine(out, line, precision);
+        if (out.size() >= flushAt) {
+            os.write(out.data(), streamsize(out.size()));
+            out.clear();
+        }
+    }
+    os.write(out.data(), streamsize(out.size()));
+}
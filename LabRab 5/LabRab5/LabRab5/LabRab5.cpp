@@ -5,6 +5,23 @@
 #include <unordered_map>
 #include <vector>
 #include <stdexcept>
+#include <chrono>
+#include <filesystem>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
@@ -63,6 +80,10 @@ private:
 public:
     FileUserRepository(const string& filename) : filename(filename) {}
 
+    const string& getFilename() const {
+        return filename;
+    }
+
     void add(const User& user) override {
         ofstream file(filename, ios::app);
         file << user.toString() << endl;
@@ -130,6 +151,553 @@ public:
     }
 };
 
+// Отпечаток файла: если он изменился, файл менялся снаружи
+struct FileStamp {
+    bool exists = false;
+    uintmax_t size = 0;
+    filesystem::file_time_type mtime{};
+    uint64_t inode = 0; // номер inode (на Windows 0 - там файл заменяют, а не переписывают)
+
+    static FileStamp of(const string& path) {
+        FileStamp stamp;
+        error_code error;
+        stamp.mtime = filesystem::last_write_time(path, error);
+        if (error) {
+            return stamp;
+        }
+        stamp.size = filesystem::file_size(path, error);
+        stamp.exists = !error;
+#ifndef _WIN32
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) {
+            stamp.inode = uint64_t(info.st_ino);
+        }
+#endif
+        return stamp;
+    }
+
+    bool operator==(const FileStamp& other) const {
+        return exists == other.exists && size == other.size && mtime == other.mtime && inode == other.inode;
+    }
+    bool operator!=(const FileStamp& other) const {
+        return !(*this == other);
+    }
+};
+
+// Класс CachedUserRepository
+// Кэш над FileUserRepository: файл читается один раз, поиск по id, логину и имени - по
+// хеш-индексам без обращения к диску. Запись идет в файл и сразу в кэш. Изменения файла
+// снаружи замечаются по отпечатку (время изменения, размер, inode), который проверяется
+// не чаще раза в checkInterval (0 - при каждом обращении)
+// Хранилище в формате users.txt; main работает с журналом LogUserRepository, у которого свои индексы
+class CachedUserRepository : public IUserRepository {
+private:
+    FileUserRepository& fileRepository;
+    chrono::steady_clock::duration checkInterval;
+    chrono::steady_clock::time_point lastCheck{};
+    FileStamp stamp;
+    bool loaded = false;
+
+    vector<User> users; // в порядке файла
+    // при повторах в файле (как и в FileUserRepository) находится первая запись
+    unordered_map<int, size_t> byId;
+    unordered_map<string, size_t> byLogin;
+    unordered_map<string, size_t> byName;
+
+    void index(size_t position) {
+        const User& user = users[position];
+        byId.emplace(user.id, position);
+        byLogin.emplace(user.login, position);
+        byName.emplace(user.name, position);
+    }
+
+    void rebuildIndexes() {
+        byId.clear();
+        byLogin.clear();
+        byName.clear();
+        for (size_t n = 0; n < users.size(); n++) {
+            index(n);
+        }
+    }
+
+    // перечитать файл, если он изменился с последней загрузки
+    // (force - проверить отпечаток сразу, не дожидаясь checkInterval)
+    void refresh(bool force = false) {
+        auto now = chrono::steady_clock::now();
+        if (loaded && !force && now - lastCheck < checkInterval) {
+            return;
+        }
+        lastCheck = now;
+        FileStamp current = FileStamp::of(fileRepository.getFilename());
+        if (loaded && current == stamp) {
+            return;
+        }
+        users = fileRepository.getAll();
+        rebuildIndexes();
+        stamp = current;
+        loaded = true;
+    }
+
+    // перед записью кэш обязан совпадать с файлом: FileUserRepository переписывает файл
+    // по его текущему содержимому, и изменение снаружи иначе потерялось бы в новом отпечатке
+    void beforeWrite() {
+        refresh(true);
+    }
+
+    // после своей записи: кэш уже обновлен, запоминаем новый отпечаток файла
+    void written() {
+        stamp = FileStamp::of(fileRepository.getFilename());
+        lastCheck = chrono::steady_clock::now();
+    }
+
+    const User& find(const unordered_map<string, size_t>& index, const string& key) {
+        refresh();
+        auto it = index.find(key);
+        if (it == index.end()) {
+            throw runtime_error("User not found");
+        }
+        return users[it->second];
+    }
+
+public:
+    CachedUserRepository(FileUserRepository& fileRepository,
+        chrono::steady_clock::duration checkInterval = chrono::seconds(1))
+        : fileRepository(fileRepository), checkInterval(checkInterval) {}
+
+    void add(const User& user) override {
+        beforeWrite();
+        fileRepository.add(user);
+        users.push_back(user);
+        index(users.size() - 1);
+        written();
+    }
+
+    void remove(int id) override {
+        beforeWrite();
+        fileRepository.remove(id);
+        vector<User> kept;
+        kept.reserve(users.size());
+        for (const auto& user : users) {
+            if (user.id != id) {
+                kept.push_back(user);
+            }
+        }
+        users.swap(kept);
+        rebuildIndexes(); // позиции сдвинулись
+        written();
+    }
+
+    void update(int id, const User& user) override {
+        beforeWrite();
+        fileRepository.update(id, user);
+        for (auto& u : users) {
+            if (u.id == id) {
+                u = user;
+            }
+        }
+        rebuildIndexes();
+        written();
+    }
+
+    User getById(int id) override {
+        refresh();
+        auto it = byId.find(id);
+        if (it == byId.end()) {
+            throw runtime_error("User not found");
+        }
+        return users[it->second];
+    }
+
+    vector<User> getAll() override {
+        refresh();
+        return users;
+    }
+
+    User getByLogin(const string& login) override {
+        return find(byLogin, login);
+    }
+
+    User getByName(const string& name) override {
+        return find(byName, name);
+    }
+
+    size_t size() {
+        refresh();
+        return users.size();
+    }
+
+    // сбросить кэш: следующее обращение перечитает файл
+    void invalidate() {
+        loaded = false;
+    }
+};
+
+// Класс LogUserRepository
+// Хранилище-журнал: каждое изменение дописывается в конец файла одной записью
+// ("P,контрольная сумма,пользователь" - запись, "D,контрольная сумма,id" - удаление),
+// так что цена add/update/remove не зависит от числа пользователей, а сбой посреди записи
+// портит только ее саму. При открытии состояние собирается заново из журнала, недописанный
+// хвост отрезается. Фоновый поток сжимает журнал: пишет живых пользователей во временный
+// файл и атомарно подменяет им журнал (rename), старый журнал до этого момента цел
+class LogUserRepository : public IUserRepository {
+private:
+    string filename;
+    bool durable;            // fsync после каждой записи
+    size_t compactMinimum;   // сжимать не раньше, чем в журнале наберется столько записей
+
+    mutex lock;
+    FILE* log = nullptr;
+    unordered_map<int, User> users;
+    unordered_map<string, set<int>> byLogin; // при повторах находится меньший id
+    unordered_map<string, set<int>> byName;
+    size_t records = 0;      // записей в журнале (живые + устаревшие)
+    bool compacting = false;
+    vector<string> pending;  // записи, пришедшие во время сжатия
+    size_t compactions = 0;
+
+    condition_variable wake;
+    bool stop = false;
+    bool compactRequested = false;
+    size_t compactRetryAt = 0; // после неудачного сжатия - не раньше, чем записей станет столько
+    thread compactor;
+
+    static uint32_t checksum(const string& text) {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 16777619u;
+        }
+        return hash;
+    }
+
+    static string record(char kind, const string& payload) {
+        char crc[9];
+        snprintf(crc, sizeof(crc), "%08x", checksum(payload));
+        return string(1, kind) + "," + crc + "," + payload + "\n";
+    }
+
+    // false - данные могли не дойти до диска
+    static bool syncFile(FILE* file) {
+        if (fflush(file) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // после rename: запись о новом файле в каталоге тоже должна попасть на диск
+    void syncDirectory() {
+#ifndef _WIN32
+        string directory = filesystem::path(filename).parent_path().string();
+        int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+#endif
+    }
+
+    void index(const User& user) {
+        byLogin[user.login].insert(user.id);
+        byName[user.name].insert(user.id);
+    }
+
+    void unindex(const User& user) {
+        auto unlink = [&](unordered_map<string, set<int>>& map, const string& key) {
+            auto it = map.find(key);
+            if (it == map.end()) {
+                return;
+            }
+            it->second.erase(user.id);
+            if (it->second.empty()) {
+                map.erase(it);
+            }
+        };
+        unlink(byLogin, user.login);
+        unlink(byName, user.name);
+    }
+
+    void applyPut(const User& user) {
+        auto it = users.find(user.id);
+        if (it != users.end()) {
+            unindex(it->second);
+            it->second = user;
+        }
+        else {
+            users.emplace(user.id, user);
+        }
+        index(user);
+    }
+
+    void applyDelete(int id) {
+        auto it = users.find(id);
+        if (it == users.end()) {
+            return;
+        }
+        unindex(it->second);
+        users.erase(it);
+    }
+
+    // разбор одной строки журнала; false - строка испорчена
+    bool replay(const string& line) {
+        if (line.size() < 11 || line[1] != ',' || line[10] != ',') {
+            return false;
+        }
+        string payload = line.substr(11);
+        if (strtoul(line.substr(2, 8).c_str(), nullptr, 16) != checksum(payload)) {
+            return false;
+        }
+        try {
+            if (line[0] == 'P') {
+                applyPut(User::fromString(payload));
+            }
+            else if (line[0] == 'D') {
+                applyDelete(stoi(payload));
+            }
+            else {
+                return false;
+            }
+        }
+        catch (const exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    // сборка состояния из журнала; хвост после первой испорченной записи отрезается
+    void load() {
+        ifstream file(filename, ios::binary);
+        uintmax_t good = 0;
+        bool damaged = false;
+        string line;
+        while (getline(file, line)) {
+            if (file.eof() || !replay(line)) { // последняя строка без перевода строки - недописана
+                damaged = true;
+                break;
+            }
+            good += line.size() + 1;
+            records++;
+        }
+        file.close();
+        if (damaged) {
+            filesystem::resize_file(filename, good);
+        }
+    }
+
+    // дописать запись (под lock)
+    void append(const string& line) {
+        if (log == nullptr || fputs(line.c_str(), log) < 0) {
+            throw runtime_error("Не удалось записать в журнал " + filename);
+        }
+        if (durable ? !syncFile(log) : fflush(log) != 0) {
+            throw runtime_error("Не удалось сохранить запись журнала " + filename);
+        }
+        records++;
+        if (compacting) {
+            pending.push_back(line);
+        }
+        else if (records >= compactMinimum && records >= compactRetryAt && records > 2 * users.size()) {
+            compactRequested = true; // устаревших записей больше, чем живых
+            wake.notify_one();
+        }
+    }
+
+    void compactLoop() {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            wake.wait(guard, [this] { return stop || compactRequested; });
+            if (stop) {
+                return;
+            }
+            compactRequested = false;
+            guard.unlock();
+            bool failed = false;
+            try {
+                compact();
+            }
+            catch (const exception& e) {
+                cerr << e.what() << endl; // журнал остается прежним, сжатие повторится позже
+                failed = true;
+            }
+            guard.lock();
+            if (failed) {
+                // не переписывать снимок на каждой записи (например, диск полон): следующая
+                // попытка - после стольких новых записей, сколько сейчас живых пользователей
+                compactRetryAt = records + max(compactMinimum, users.size());
+            }
+        }
+    }
+
+public:
+    LogUserRepository(const string& filename, bool durable = true, size_t compactMinimum = 1000)
+        : filename(filename), durable(durable), compactMinimum(compactMinimum) {
+        filesystem::remove(filename + ".compact"); // остаток прерванного сжатия
+        load();
+        log = fopen(filename.c_str(), "ab");
+        if (log == nullptr) {
+            throw runtime_error("Не удалось открыть журнал " + filename);
+        }
+        compactRequested = records >= compactMinimum && records > 2 * users.size();
+        compactor = thread([this] { compactLoop(); });
+    }
+
+    ~LogUserRepository() {
+        {
+            lock_guard<mutex> guard(lock);
+            stop = true;
+        }
+        wake.notify_one();
+        compactor.join();
+        fclose(log);
+    }
+
+    LogUserRepository(const LogUserRepository&) = delete;
+    LogUserRepository& operator=(const LogUserRepository&) = delete;
+
+    // сжатие журнала: снимок живых пользователей пишется без блокировки, потом под
+    // блокировкой дописываются записи, пришедшие за это время, и файл подменяется
+    void compact() {
+        string temporary = filename + ".compact";
+        vector<User> snapshot;
+        {
+            lock_guard<mutex> guard(lock);
+            if (compacting) {
+                return;
+            }
+            compacting = true;
+            pending.clear();
+            snapshot.reserve(users.size());
+            for (const auto& entry : users) {
+                snapshot.push_back(entry.second);
+            }
+        }
+        FILE* out = fopen(temporary.c_str(), "wb");
+        bool ok = out != nullptr;
+        for (size_t n = 0; ok && n < snapshot.size(); n++) {
+            ok = fputs(record('P', snapshot[n].toString()).c_str(), out) >= 0;
+        }
+        lock_guard<mutex> guard(lock);
+        compacting = false;
+        for (size_t n = 0; ok && n < pending.size(); n++) {
+            ok = fputs(pending[n].c_str(), out) >= 0;
+        }
+        if (out != nullptr) {
+            ok = syncFile(out) && ok;
+            ok = fclose(out) == 0 && ok;
+        }
+        if (!ok) {
+            error_code ignored;
+            filesystem::remove(temporary, ignored); // ошибка удаления не должна заслонить причину
+            throw runtime_error("Не удалось сжать журнал " + filename);
+        }
+        fclose(log); // на Windows открытый файл нельзя подменить
+        error_code error;
+        filesystem::rename(temporary, filename, error); // точка фиксации: до нее действует старый журнал
+        log = fopen(filename.c_str(), "ab");
+        if (error || log == nullptr) {
+            throw runtime_error("Не удалось подменить журнал " + filename);
+        }
+        syncDirectory();
+        records = snapshot.size() + pending.size();
+        pending.clear();
+        compactions++;
+    }
+
+    void add(const User& user) override {
+        lock_guard<mutex> guard(lock);
+        append(record('P', user.toString()));
+        applyPut(user);
+    }
+
+    void remove(int id) override {
+        lock_guard<mutex> guard(lock);
+        if (users.count(id) == 0) {
+            return;
+        }
+        append(record('D', to_string(id)));
+        applyDelete(id);
+    }
+
+    void update(int id, const User& user) override {
+        lock_guard<mutex> guard(lock);
+        if (users.count(id) == 0) {
+            return;
+        }
+        if (user.id != id) {
+            append(record('D', to_string(id)));
+            applyDelete(id);
+        }
+        append(record('P', user.toString()));
+        applyPut(user);
+    }
+
+    User getById(int id) override {
+        lock_guard<mutex> guard(lock);
+        auto it = users.find(id);
+        if (it == users.end()) {
+            throw runtime_error("User not found");
+        }
+        return it->second;
+    }
+
+    // все пользователи по возрастанию id
+    vector<User> getAll() override {
+        lock_guard<mutex> guard(lock);
+        vector<User> all;
+        all.reserve(users.size());
+        for (const auto& entry : users) {
+            all.push_back(entry.second);
+        }
+        sort(all.begin(), all.end(), [](const User& a, const User& b) { return a.id < b.id; });
+        return all;
+    }
+
+    User getByLogin(const string& login) override {
+        lock_guard<mutex> guard(lock);
+        auto it = byLogin.find(login);
+        if (it == byLogin.end()) {
+            throw runtime_error("User not found");
+        }
+        return users.at(*it->second.begin());
+    }
+
+    User getByName(const string& name) override {
+        lock_guard<mutex> guard(lock);
+        auto it = byName.find(name);
+        if (it == byName.end()) {
+            throw runtime_error("User not found");
+        }
+        return users.at(*it->second.begin());
+    }
+
+    size_t size() {
+        lock_guard<mutex> guard(lock);
+        return users.size();
+    }
+
+    // свободный id для нового пользователя
+    int nextId() {
+        lock_guard<mutex> guard(lock);
+        int id = 0;
+        for (const auto& entry : users) {
+            id = max(id, entry.first);
+        }
+        return id + 1;
+    }
+
+    size_t logRecords() {
+        lock_guard<mutex> guard(lock);
+        return records;
+    }
+
+    size_t compactionCount() {
+        lock_guard<mutex> guard(lock);
+        return compactions;
+    }
+};
+
 // Интерфейс IUserManager
 class IUserManager {
 public:
@@ -185,7 +753,16 @@ public:
 // Основная программа
 int main() {
     setlocale(LC_ALL, "Russian");
-    FileUserRepository userRepository("users.txt");
+    // первый запуск - журнала еще нет; пустой журнал (все пользователи удалены) - не первый
+    bool firstRun = !filesystem::exists("users.log");
+    LogUserRepository userRepository("users.log"); // изменения дописываются в журнал
+    if (firstRun) {
+        // переносим пользователей из прежнего users.txt
+        FileUserRepository fileRepository("users.txt");
+        for (const auto& user : fileRepository.getAll()) {
+            userRepository.add(user);
+        }
+    }
     FileUserManager userManager(userRepository);
 
     // Проверка, если пользователь уже авторизован, делаем автоматический вход
@@ -203,7 +780,7 @@ int main() {
         cout << "Пароль: ";
         cin >> password;
 
-        int newId = userRepository.getAll().size() + 1;
+        int newId = userRepository.nextId();
         userRepository.add(User(newId, name, login, password));
         cout << "Пользователь зарегистрирован!" << endl;
 
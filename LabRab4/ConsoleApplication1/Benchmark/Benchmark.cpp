@@ -0,0 +1,594 @@
+﻿//замеры клавиатуры: генератор нагрузки и замеры отдельных механизмов
+//(режим check - не замер, а проверки поведения; код возврата 1, если что-то не так)
+//Benchmark [load|features|all|check] [--keys 10,1000] [--events N] [--threads 1,4]
+//          [--workload press,undo,mixed] [--path linear,indexed,id,queue] [--sample N] [--rate N]
+//по умолчанию производители выдают события без пауз (замер пропускной способности, задержка
+//очереди тогда - время ожидания в полной очереди); --rate задает темп каждого производителя
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include "command.hpp"
+#include "keyboard.hpp"
+#include "dispatcher.hpp"
+using namespace std;
+
+//команда без вывода в консоль - для замеров (считает срабатывания во внешнем счетчике)
+class CountCommand : public Command
+{
+public:
+    int64_t* m_count = nullptr;
+    explicit CountCommand(int64_t* count) : Command() { m_name = "Count"; m_count = count; };
+    void Activation() override { (*m_count)++; }
+    void Undo() override { (*m_count)--; }
+};
+
+//долгая команда без вывода: шаги через паузу, по завершении увеличивает счетчик
+class CountRamp : public AsyncCommand
+{
+public:
+    int m_steps = 5;
+    chrono::milliseconds m_step{ 10 };
+    size_t* m_done = nullptr;
+
+    CountRamp(int steps, chrono::milliseconds step, size_t* done) : AsyncCommand()
+    {
+        m_name = "Count ramp";
+        m_steps = steps;
+        m_step = step;
+        m_done = done;
+    }
+
+    CommandTask Run() override
+    {
+        for (int n = 0; n < m_steps; n++) { co_await Delay(m_step); }
+        (*m_done)++;
+    }
+};
+
+//команда, которая нажимает другую клавишу той же клавиатуры (как макрос из одного нажатия)
+class PressOther : public Command
+{
+public:
+    KeyBoard* m_board = nullptr;
+    KeyId m_target = 0;
+    PressOther(KeyBoard* board, KeyId target) : Command() { m_name = "Press other"; m_board = board; m_target = target; };
+    void Activation() override { m_board->PressKey(m_target); }
+    void Undo() override {}
+};
+
+//команда, которая подает событие в автомат последовательностей (Feed)
+class FeedChord : public Command
+{
+public:
+    KeyBoard* m_board = nullptr;
+    string m_chord;
+    FeedChord(KeyBoard* board, string chord) : Command() { m_name = "Feed chord"; m_board = board; m_chord = move(chord); };
+    void Activation() override { m_board->Feed(m_chord); }
+    void Undo() override {}
+};
+
+//путь выдачи нажатий
+enum class Path
+{
+    Linear,     //PressKeyLinear: перебор всех клавиш по имени
+    Indexed,    //PressKey(имя): хеш-индекс
+    ById,       //PressKey(номер)
+    Queue       //KeyDispatcher: очередь и отдельный поток
+};
+
+//нагрузка
+enum class Workload
+{
+    Press,      //только нажатия
+    Undo,       //только отмены (история заполняется заранее)
+    Mixed       //три нажатия на одну отмену
+};
+
+const char* PathName(Path path)
+{
+    static const char* names[] = { "linear", "indexed", "id", "queue" };
+    return names[size_t(path)];
+}
+
+const char* WorkloadName(Workload workload)
+{
+    static const char* names[] = { "press", "undo", "mixed" };
+    return names[size_t(workload)];
+}
+
+//настройки запуска из командной строки
+struct Options
+{
+    string mode = "all";
+    vector<size_t> keys = { 10, 1000, 10000, 100000 };
+    size_t events = 200000;                     //событий на поток
+    vector<size_t> threads = { 1, 4 };
+    vector<Workload> workloads = { Workload::Press, Workload::Undo, Workload::Mixed };
+    vector<Path> paths = { Path::Linear, Path::Indexed, Path::ById, Path::Queue };
+    uint32_t sample = 16;                       //время снимается у каждого n-го события (прямые пути)
+    double rate = 0;                            //событий в секунду на поток (0 - без пауз)
+};
+
+//одна операция генератора: нажатие клавиши или отмена
+struct Operation
+{
+    KeyId m_key = 0;
+    bool m_undo = false;
+};
+
+//результат одного запуска
+struct LoadResult
+{
+    size_t events = 0;
+    double seconds = 0;
+    ProbeSummary latency;
+    uint64_t retries = 0;   //повторов Post при полной очереди
+};
+
+//последовательность операций одного потока (заранее, чтобы не мерить генератор случайных чисел)
+vector<Operation> MakeOperations(Workload workload, size_t keys, size_t events, uint64_t seed)
+{
+    vector<Operation> ops(events);
+    uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+    for (size_t n = 0; n < events; n++)
+    {
+        state ^= state << 13; //xorshift64
+        state ^= state >> 7;
+        state ^= state << 17;
+        ops[n].m_key = KeyId(state % keys);
+        ops[n].m_undo = workload == Workload::Undo || (workload == Workload::Mixed && n % 4 == 3);
+    }
+    return ops;
+}
+
+//темп производителя: событие n выдается не раньше start + n / rate
+void Pace(int64_t start_ns, size_t n, double rate)
+{
+    if (rate <= 0) { return; }
+    int64_t due = start_ns + int64_t(double(n) * 1e9 / rate);
+    while (MetricsRegistry::Now() < due) { this_thread::yield(); }
+}
+
+//прогон: keys клавиш, threads потоков-производителей по events событий в каждом
+LoadResult RunLoad(Path path, Workload workload, size_t keys, size_t threads, size_t events, uint32_t sample, double rate)
+{
+    size_t total = threads * events;
+    KeyBoard board(max<size_t>(total, 1024)); //при отменах история должна вместить все заполнение
+    board.SetEcho(false);
+    int64_t count = 0;
+    vector<string> names;
+    names.reserve(keys);
+    for (size_t n = 0; n < keys; n++)
+    {
+        names.push_back("KEY " + to_string(n));
+        board.AddKey(Key(names.back(), CountCommand(&count)));
+    }
+    if (workload == Workload::Undo) //заполнение истории (не входит в замер)
+    {
+        for (size_t n = 0; n < total; n++) { board.PressKey(KeyId(n % keys)); }
+    }
+    vector<vector<Operation>> ops;
+    for (size_t p = 0; p < threads; p++) { ops.push_back(MakeOperations(workload, keys, events, p + 1)); }
+
+    LoadResult result;
+    result.events = total;
+    vector<thread> producers;
+
+    if (path == Path::Queue)
+    {
+        KeyDispatcher dispatcher(board, 1 << 16);
+        dispatcher.Start();
+        auto start = chrono::steady_clock::now();
+        for (size_t p = 0; p < threads; p++)
+        {
+            producers.emplace_back([&, p]
+                {
+                    int64_t begin = MetricsRegistry::Now();
+                    for (size_t n = 0; n < ops[p].size(); n++)
+                    {
+                        const Operation& op = ops[p][n];
+                        Pace(begin, n, rate);
+                        while (!(op.m_undo ? dispatcher.PostUndo() : dispatcher.Post(op.m_key))) { this_thread::yield(); } //очередь полна
+                    }
+                });
+        }
+        for (auto& t : producers) { t.join(); }
+        dispatcher.Stop(); //дожидается выполнения всего, что в очереди
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        DispatchMetrics m = dispatcher.Metrics();
+        result.retries = m.dropped;
+        result.latency.count = m.dispatched;
+        result.latency.mean_ns = m.avg_latency_us * 1000;
+        result.latency.p50_ns = uint64_t(m.p50_latency_us * 1000);
+        result.latency.p99_ns = uint64_t(m.p99_latency_us * 1000);
+        result.latency.p999_ns = uint64_t(m.p999_latency_us * 1000);
+        result.latency.max_ns = uint64_t(m.max_latency_us * 1000);
+        return result;
+    }
+
+    //прямые пути: клавиатура не потокобезопасна, несколько производителей идут через мьютекс
+    //(время ожидания мьютекса входит в задержку, как очередь входит в задержку диспетчера)
+    mutex board_mutex;
+    vector<unique_ptr<LatencyHistogram>> latency; //у каждого потока своя гистограмма
+    for (size_t p = 0; p < threads; p++) { latency.push_back(make_unique<LatencyHistogram>()); }
+    bool shared = threads > 1;
+    uint32_t mask = sample - 1;
+    auto execute = [&](const Operation& op)
+    {
+        if (op.m_undo) { board.Undo(); return; }
+        switch (path)
+        {
+        case Path::Linear: board.PressKeyLinear(names[op.m_key]); break;
+        case Path::Indexed: board.PressKey(string_view(names[op.m_key])); break;
+        default: board.PressKey(op.m_key); break;
+        }
+    };
+    auto start = chrono::steady_clock::now();
+    for (size_t p = 0; p < threads; p++)
+    {
+        producers.emplace_back([&, p]
+            {
+                LatencyHistogram& histogram = *latency[p];
+                uint32_t tick = 0;
+                int64_t paced = MetricsRegistry::Now();
+                for (size_t n = 0; n < ops[p].size(); n++)
+                {
+                    const Operation& op = ops[p][n];
+                    Pace(paced, n, rate);
+                    bool timed = (tick++ & mask) == 0;
+                    int64_t begin = timed ? MetricsRegistry::Now() : 0;
+                    if (shared)
+                    {
+                        lock_guard<mutex> lock(board_mutex);
+                        execute(op);
+                    }
+                    else { execute(op); }
+                    if (timed) { histogram.Record(uint64_t(MetricsRegistry::Now() - begin)); }
+                }
+            });
+    }
+    for (auto& t : producers) { t.join(); }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    vector<uint64_t> counts(LatencyHistogram::Buckets);
+    uint64_t timed = 0, sum = 0, max_ns = 0;
+    for (const auto& histogram : latency) { histogram->AddTo(counts, timed, sum, max_ns); }
+    result.latency = LatencyHistogram::Summarize(counts, timed, sum, max_ns);
+    return result;
+}
+
+//таблица сравнения путей выдачи при разном числе клавиш, нагрузках и потоках
+void BenchLoad(const Options& options)
+{
+    cout << left << setw(8) << "keys" << setw(9) << "path" << setw(8) << "load" << setw(8) << "threads" << right
+         << setw(10) << "events" << setw(14) << "events/s" << setw(11) << "p50 us" << setw(11) << "p99 us"
+         << setw(11) << "p999 us" << setw(11) << "max us" << endl;
+    streamsize precision = cout.precision();
+    cout << fixed;
+    for (size_t keys : options.keys)
+    {
+        for (Workload workload : options.workloads)
+        {
+            for (Path path : options.paths)
+            {
+                for (size_t threads : options.threads)
+                {
+                    size_t events = options.events;
+                    if (path == Path::Linear) //перебор: ограничиваем общее число сравнений
+                    {
+                        events = min(events, max<size_t>(1000, 50000000 / keys / threads));
+                    }
+                    LoadResult r = RunLoad(path, workload, keys, threads, events, options.sample, options.rate);
+                    cout << left << setw(8) << keys << setw(9) << PathName(path) << setw(8) << WorkloadName(workload)
+                         << setw(8) << threads << right << setw(10) << r.events << setw(14) << setprecision(0)
+                         << double(r.events) / r.seconds << setprecision(3)
+                         << setw(11) << double(r.latency.p50_ns) / 1000 << setw(11) << double(r.latency.p99_ns) / 1000
+                         << setw(11) << double(r.latency.p999_ns) / 1000 << setw(11) << double(r.latency.max_ns) / 1000;
+                    if (r.retries > 0) { cout << "  (queue full " << r.retries << " times)"; }
+                    cout << endl;
+                }
+            }
+        }
+    }
+    cout << defaultfloat << setprecision(int(precision));
+}
+
+//замер воспроизведения макроса из миллиона нажатий без пауз
+void BenchMacro(size_t events)
+{
+    KeyBoard board(1 << 16);
+    int64_t count = 0;
+    vector<KeyId> ids;
+    for (size_t n = 0; n < 100; n++) { ids.push_back(board.AddKey(Key("KEY " + to_string(n), CountCommand(&count)))); }
+    auto macro = make_shared<Macro>(false);
+    for (size_t n = 0; n < events; n++) { macro->Append(ids[(n * 31) % ids.size()]); }
+    auto start = chrono::steady_clock::now();
+    board.Play(macro, ReplayMode::Fast);
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    cout << "macro replay: " << double(events) / seconds.count() << " events/s, " << macro->Bytes() << " bytes for "
+         << events << " events" << endl;
+}
+
+//цена журнала в PressKey: те же нажатия без журнала и с журналом (групповая фиксация)
+void BenchJournal(size_t presses)
+{
+    int64_t count = 0;
+    auto run = [&](Journal* journal)
+    {
+        KeyBoard board(1 << 16);
+        vector<KeyId> ids;
+        for (size_t n = 0; n < 100; n++) { ids.push_back(board.AddKey(Key("KEY " + to_string(n), CountCommand(&count)))); }
+        board.AttachJournal(journal);
+        auto start = chrono::steady_clock::now();
+        for (size_t n = 0; n < presses; n++) { board.PressKey(ids[(n * 31) % ids.size()]); }
+        chrono::duration<double, micro> us = chrono::steady_clock::now() - start;
+        return us.count() / double(presses);
+    };
+    double plain = run(nullptr);
+    double journaled;
+    uint64_t commits;
+    {
+        Journal journal("bench.kjl");
+        journaled = run(&journal);
+        journal.Flush();
+        commits = journal.Commits();
+    }
+    remove("bench.kjl");
+    cout << "journal: " << plain << " us/press without, " << journaled << " us/press with, "
+         << presses << " records in " << commits << " fsync" << endl;
+}
+
+//замер автомата: 10k последовательностей из двух сочетаний, события по одному
+void BenchFeed(size_t events)
+{
+    KeyBoard board(1 << 16);
+    int64_t count = 0;
+    vector<pair<string, string>> steps;
+    for (size_t n = 0; n < 10000; n++)
+    {
+        steps.push_back({ "Ctrl+K" + to_string(n % 100), "Shift+" + to_string(n / 100) });
+        board.AddKey(Key(steps.back().first + ", " + steps.back().second, CountCommand(&count)));
+    }
+    auto start = chrono::steady_clock::now();
+    for (size_t n = 0; n < events; n++)
+    {
+        const auto& step = steps[(n * 7919) % steps.size()];
+        board.Feed(step.first);
+        board.Feed(step.second);
+    }
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    cout << "sequences: " << double(2 * events) / seconds.count() << " events/s (" << count << " fired)" << endl;
+}
+
+//замер исполнителя корутин: тысячи долгих команд одновременно в одном потоке
+void BenchCoroutines(size_t commands)
+{
+    KeyBoard board(1 << 16);
+    size_t done = 0;
+    KeyId ramp = board.AddKey(Key("RAMP", CountRamp(5, chrono::milliseconds(10), &done)));
+    auto start = chrono::steady_clock::now();
+    for (size_t n = 0; n < commands; n++) { board.PressKey(ramp); }
+    size_t in_flight = board.RunningCommands();
+    board.Drain();
+    chrono::duration<double, milli> ms = chrono::steady_clock::now() - start;
+    cout << "coroutines: " << in_flight << " in flight, " << done << " finished in " << ms.count() << " ms" << endl;
+}
+
+//результат одной проверки режима check
+int g_check_failures = 0;
+void Check(bool ok, string_view what)
+{
+    cout << (ok ? "[ok]   " : "[FAIL] ") << what << endl;
+    if (!ok) { g_check_failures++; }
+}
+
+//отмена таймера, уже забранного в пачку колеса: клавиша с подавлением дребезга, которую
+//повторно нажимает задача, выполненная раньше в той же пачке, срабатывает один раз
+void CheckDebounceInBatch()
+{
+    KeyBoard board;
+    int64_t count = 0;
+    KeyId quiet = board.AddKey(Key("QUIET", CountCommand(&count), DispatchPolicy::Debounce(chrono::milliseconds(6))));
+    KeyId other = board.AddKey(Key("OTHER", PressOther(&board, quiet), DispatchPolicy::Debounce(chrono::milliseconds(5))));
+    board.PressKey(quiet);  //выдача через 6 мс
+    board.PressKey(other);  //через 5 мс - раньше в той же пачке, снова нажимает QUIET
+    this_thread::sleep_for(chrono::milliseconds(20));
+    board.Poll();           //обе выдачи в одной пачке
+    board.Drain();
+    Check(count == 1, "дребезг: выдача, отмененная внутри пачки колеса, не срабатывает");
+}
+
+//таймаут последовательности и ее продолжение в одной пачке колеса: продолжение отменяет
+//таймаут, и короткая привязка не срабатывает вдобавок к длинной
+void CheckSequenceTimeoutInBatch()
+{
+    KeyBoard board;
+    int64_t short_count = 0, middle_count = 0, long_count = 0;
+    board.AddKey(Key("g", CountCommand(&short_count)));
+    board.AddKey(Key("g, g", CountCommand(&middle_count)));
+    board.AddKey(Key("g, g, g", CountCommand(&long_count)));
+    KeyId feeder = board.AddKey(Key("FEEDER", FeedChord(&board, "g"), DispatchPolicy::Debounce(chrono::milliseconds(5))));
+    board.SetSequenceTimeout(chrono::milliseconds(6));
+    board.Feed("g");            //ждет продолжения, таймаут через 6 мс
+    board.PressKey(feeder);     //через 5 мс - раньше в той же пачке подает второе "g"
+    this_thread::sleep_for(chrono::milliseconds(20));
+    board.Poll();
+    board.Feed("g");            //третье "g" - до нового таймаута
+    board.Drain();
+    Check(long_count == 1 && middle_count == 0 && short_count == 0,
+        "последовательность: таймаут из той же пачки, что и продолжение, не срабатывает");
+}
+
+//восстановление из журнала с клавишей-макросом: вложенные нажатия применяются один раз,
+//состояние и история после Recover - как до "сбоя"
+void CheckRecoverMacro()
+{
+    const char* path = "check.kjl";
+    auto macro = make_shared<Macro>(false);
+    int64_t before_count = 0, after_count = 0;
+    size_t before_history = 0;
+    {
+        Journal journal(path);
+        KeyBoard before;
+        before.SetEcho(false);
+        KeyId key = before.AddKey(Key("KEY", CountCommand(&before_count)));
+        macro->Append(key);
+        macro->Append(key);
+        KeyId play = before.AddKey(Key("MACRO", MacroCommand(before, macro)));
+        before.AttachJournal(&journal);
+        before.PressKey(play);
+        before.PressKey(key);
+        before.PressKey(key);
+        before.Undo();
+        journal.Flush();
+        before_history = before.History().Done();
+    }
+    KeyBoard after;
+    after.SetEcho(false);
+    after.AddKey(Key("KEY", CountCommand(&after_count)));
+    after.AddKey(Key("MACRO", MacroCommand(after, macro)));
+    after.Recover(path);
+    remove(path);
+    Check(after_count == before_count && after.History().Done() == before_history,
+        "журнал: нажатия макроса после восстановления применены один раз");
+}
+
+//макрос с паузами, который нажимает свою же клавишу: вложенность считается и для шагов
+//из таймеров, поэтому перезапуск останавливается на max_replay_depth, а не идет бесконечно
+void CheckTimedMacroRecursion()
+{
+    KeyBoard board;
+    board.SetEcho(false);
+    int64_t count = 0;
+    auto macro = make_shared<Macro>(true);
+    KeyId key = board.AddKey(Key("KEY", CountCommand(&count)));
+    KeyId play = board.AddKey(Key("MACRO", MacroCommand(board, macro, ReplayMode::RealTime)));
+    macro->Append(key, 0);
+    macro->Append(play, 1000); //через 1 мс - снова сам макрос
+    board.PressKey(play);
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(500);
+    while (board.PendingCommands() > 0 && chrono::steady_clock::now() < deadline)
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        board.Poll();
+    }
+    Check(board.PendingCommands() == 0 && count > 0 && count <= 8,
+        "макрос с паузами: рекурсия останавливается на предельной вложенности");
+}
+
+//список через запятую: "10,1000" или "press,mixed"
+vector<string> SplitList(string_view text)
+{
+    vector<string> items;
+    size_t start = 0;
+    for (size_t pos; (pos = text.find(',', start)) != string_view::npos; start = pos + 1)
+    {
+        items.emplace_back(text.substr(start, pos - start));
+    }
+    items.emplace_back(text.substr(start));
+    return items;
+}
+
+Options ParseOptions(int argc, char* argv[])
+{
+    Options options;
+    int n = 1;
+    if (n < argc && argv[n][0] != '-') { options.mode = argv[n++]; }
+    if (options.mode != "load" && options.mode != "features" && options.mode != "all" && options.mode != "check")
+    {
+        throw invalid_argument("Неизвестный режим " + options.mode);
+    }
+    for (; n < argc; n++)
+    {
+        string name = argv[n];
+        if (n + 1 >= argc) { throw invalid_argument("Нет значения для " + name); }
+        vector<string> values = SplitList(argv[++n]);
+        if (name == "--keys" || name == "--threads")
+        {
+            vector<size_t>& target = name == "--keys" ? options.keys : options.threads;
+            target.clear();
+            for (const string& value : values)
+            {
+                size_t number = stoul(value);
+                if (number == 0) { throw invalid_argument(name + " должно быть больше нуля"); }
+                target.push_back(number);
+            }
+        }
+        else if (name == "--events") { options.events = stoul(values.at(0)); }
+        else if (name == "--sample")
+        {
+            options.sample = uint32_t(stoul(values.at(0)));
+            if (options.sample == 0 || (options.sample & (options.sample - 1)) != 0)
+            {
+                throw invalid_argument("Шаг выборки должен быть степенью двойки");
+            }
+        }
+        else if (name == "--rate") { options.rate = stod(values.at(0)); }
+        else if (name == "--workload")
+        {
+            options.workloads.clear();
+            for (const string& value : values)
+            {
+                if (value == "press") { options.workloads.push_back(Workload::Press); }
+                else if (value == "undo") { options.workloads.push_back(Workload::Undo); }
+                else if (value == "mixed") { options.workloads.push_back(Workload::Mixed); }
+                else { throw invalid_argument("Неизвестная нагрузка " + value); }
+            }
+        }
+        else if (name == "--path")
+        {
+            options.paths.clear();
+            for (const string& value : values)
+            {
+                if (value == "linear") { options.paths.push_back(Path::Linear); }
+                else if (value == "indexed") { options.paths.push_back(Path::Indexed); }
+                else if (value == "id") { options.paths.push_back(Path::ById); }
+                else if (value == "queue") { options.paths.push_back(Path::Queue); }
+                else { throw invalid_argument("Неизвестный путь " + value); }
+            }
+        }
+        else { throw invalid_argument("Неизвестный параметр " + name); }
+    }
+    return options;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        cerr << "Benchmark [load|features|all|check] [--keys 10,1000] [--events N] [--threads 1,4]" << endl
+             << "          [--workload press,undo,mixed] [--path linear,indexed,id,queue] [--sample N] [--rate N]" << endl;
+        return 1;
+    }
+    if (options.mode == "check")
+    {
+        CheckDebounceInBatch();
+        CheckSequenceTimeoutInBatch();
+        CheckRecoverMacro();
+        CheckTimedMacroRecursion();
+        return g_check_failures == 0 ? 0 : 1;
+    }
+    if (options.mode != "features") { BenchLoad(options); }
+    if (options.mode != "load")
+    {
+        BenchMacro(1000000);
+        BenchJournal(1000000);
+        BenchFeed(500000);
+        BenchCoroutines(10000);
+    }
+    return 0;
+}
@@ -1,176 +1,51 @@
-﻿#include <thread> //для sleep_for()
-#include <iostream>
+﻿#include <iostream>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "command.hpp"
+#include "keyboard.hpp"
 using namespace std;
 
-//класс команды
-class Command //класс родитель
+//плавное изменение громкости: шаги через паузу, клавиатура при этом не блокируется
+class VolumeRamp : public AsyncCommand
 {
-protected:
-    string m_name;
-    bool m_undo_flag = false; //флажок для функции отмены
 public:
-    Command() { m_name = "Command"; };
+    int m_steps = 10;
+    chrono::milliseconds m_step{ 200 };
 
-    // virtual значит, что функция может быть переопределена в потомках
-    virtual void Activation() {};
-    string GetName() { return m_name; };    //геттер
-    virtual void Undo() {};                 //команда отмены
-};
-
-//классы-потомки
-class SpeedUp : public Command //команда увеличения скорости (с наследованием класса команда)
-{
-public:
-    SpeedUp() : Command() { m_name = "Speed up"; };
-
-    //override для переопределения функций
-    void Activation() override { cout << "Volume Speed Increased" << endl; }
-    void Undo() override { m_undo_flag = true; }    //команда отмены
-};
-
-class SpeedDown : public Command //команда уменьшения скорости (с наследованием класса команда)
-{
-public:
-    SpeedDown() : Command() { m_name = "Speed down"; };
-
-    //override для переопределения функций
-    void Activation() override { cout << "Volume Speed Decreased" << endl; }
-    void Undo() override { m_undo_flag = true; }    //команда отмены 
-};
-
-class VolumeUp : public Command //команда увеличения громкости (с наследованием класса команда)
-{
-public:
-    VolumeUp() : Command() { m_name = "Volume up"; };
-
-    //override для переопределения функций
-    void Activation() override { cout << "Volume Level Increased" << endl; }
-    void Undo() override { m_undo_flag = true; }    //команда отмены
-};
-
-class VolumeDown : public Command //команда уменьшения громкости (с наследованием класса команда)
-{
-public:
-    VolumeDown() : Command() { m_name = "Volume down"; };
-
-    //override для переопределения функций
-    void Activation() override { cout << "Volume Level Decreased" << endl; }
-    void Undo() override { m_undo_flag = true; }    //команда отмены
-};
-
-class PressCommand : public Command //команда активации (с наследованием класса команда)
-{
-public:
-    PressCommand() : Command() { m_name = "PressCommand"; };
-
-    //override для переопределения функций
-    void Activation() override { cout << "Command activated:" << m_name << endl; }
-    void Undo() override //команда отмены
-    {
-        cout << "Undo: " << m_name << endl;
-        m_undo_flag = true;
-    }
-};
-
-//класс клавиши
-class Key
-{
-private:
-    string m_name = ""; //пустые строки
-    string m_com_name = "";
-
-    Command* m_command = nullptr; //пока что пустой указатель на объект класса Command
-    bool m_undo_flag = false; //флажок для отмены
-
-public:
-    Key(string name, Command* command)
-    {
-        m_command = command; //присваем значения
-        m_name = name;
-    }
-
-    void Press() //команда активации
-    {
-        m_command->Activation(); //m_command указывает на объект класса Command - функцию активации 
-        this_thread::sleep_for(chrono::milliseconds(500)); //приостанавливает выполнение программы на 500 миллисекунд
-    }
-
-    void KeyUndo() //команда отмены
+    VolumeRamp(int steps, chrono::milliseconds step) : AsyncCommand()
     {
-        m_command->Undo(); //m_command указывает на объект класса Command - функцию отмены
-        this_thread::sleep_for(chrono::milliseconds(500)); //приостанавливает выполнение программы на 500 миллисекунд
+        m_name = "Volume ramp";
+        m_steps = steps;
+        m_step = step;
     }
 
-    string GetName() { return m_name; } //геттер
-};
-
-//класс клавиатуры
-class KeyBoard
-{
-private:
-    vector <Key> m_keys{}; //векторы
-    vector <Key> m_log{}; //логгер
-
-public:
-    KeyBoard() {}
-
-    void AddKey(Key key) { m_keys.push_back(key); } //заполняем вектор
-    void PressKey(string key_name)
+    //один шаг как отдельная корутина - ее можно ждать из других команд
+    CommandTask Step(int n)
     {
-        bool flag = false;
-        for (int x = 0; x < m_keys.size(); x++)
-        {
-            if (m_keys[x].GetName() == key_name)  // проверяем, есть ли клавиша с именем key_name в векторе m_keys
-                //если да, вызываем команду активации для этой клавиши
-            {
-                m_keys[x].Press();
-                flag = true;
-                m_log.push_back(m_keys[x]); //добавляем в вектор логов эту клавишу
-            }
-        }
-        if (flag == false) { cout << "[Unable key]" << endl; } //если нет - ошибка
+        cout << "Volume ramp " << n << "/" << m_steps << endl;
+        co_await Delay(m_step);
     }
 
-    void Undo() // отмена команды
+    CommandTask Run() override
     {
-        Key temp = m_keys[m_keys.size() - 1]; //последний элемент вектора клавиши
-        cout << "[Undo command]: " << temp.GetName() << endl; //сообщение об отмене  команды
-        temp.KeyUndo(); //отмена команды
-        m_log.pop_back(); //убираем последний элемент из вектора логов
-    }
-
-    void ActiveCommands() //красивый вывод в консоль
-    {
-        cout << "\033[38;5;122m" << endl; //перекрашиваем текст, чтоб было красиво
-        this_thread::sleep_for(chrono::milliseconds(500)); //приостанавка программы на 500 миллисекунд
-        //выводим активные команады
-        cout << endl;
-        cout << "________________________________________________________________________________________________________________________";
-        cout << "Active commands: " << endl;
-        for (int c = 0; c < m_log.size(); c++) //выводим из вектора логов
-        {
-            cout << m_log[c].GetName() << endl;
-        }
-        cout << endl;
-        cout << "________________________________________________________________________________________________________________________";
-        cout << endl;
-        this_thread::sleep_for(chrono::milliseconds(500)); //приостанавка программы на 500 миллисекунд
-        cout << "\033[0m" << endl;//перекрашиваем текст обратно
+        for (int n = 1; n <= m_steps; n++) { co_await Step(n); }
+        cout << "Volume ramp finished" << endl;
     }
 };
 
-
 int main()
 {
     KeyBoard test;
+    test.Metrics().SetSampleEvery(1); //в примере нажатий мало - замеряем каждое
 
     //пример 1
-    SpeedUp s1; //увеличиваем скорость
-    // VolumeDown s1; //уменьшаем громкость
+    //клавиша владеет своей командой: увеличиваем скорость
+    //(или VolumeDown() - уменьшаем громкость)
     string example1_ = "EXP 1";
-    Key example1(example1_, &s1);
+    Key example1(example1_, SpeedUp());
     test.AddKey(example1); //добавляем клавишу
 
 
@@ -183,10 +58,97 @@ int main()
     test.PressKey("EXP 1");//повторная активация
 
     //пример 2 
-    //VolumeUp s2; //увеличиваем громкость
-    SpeedDown s2; //понижаем скорость
+    //понижаем скорость (или VolumeUp() - увеличиваем громкость)
     string example2_ = "EXP 2";
-    Key second(example2_, &s2);
+    Key second(example2_, SpeedDown());
     test.AddKey(second);//добавляем клавишу
     test.PressKey("EXP 2"); //активация
-    test.ActiveCommands(); //смотрим какие команды активны
\ No newline at end of file
+    test.ActiveCommands(); //смотрим какие команды активны
+
+    //пример 3: громкость с темпом 100 мс - серия нажатий не блокирует программу,
+    //команды выдаются по одной раз в 100 мс по мере вызова Poll()
+    test.AddKey(Key("EXP 3", VolumeUp(), DispatchPolicy::Pace(chrono::milliseconds(100))));
+    for (int n = 0; n < 5; n++) { test.PressKey("EXP 3"); }
+
+    //пример 4: подавление дребезга - из серии нажатий остается одно
+    test.AddKey(Key("EXP 4", VolumeDown(), DispatchPolicy::Debounce(chrono::milliseconds(50))));
+    for (int n = 0; n < 5; n++) { test.PressKey("EXP 4"); }
+
+    cout << "Pending commands: " << test.PendingCommands() << endl;
+    test.Drain(); //ждем отложенные команды перед выходом
+    test.ActiveCommands();
+
+    //пример 5: отмена и повтор по истории
+    test.Undo();
+    test.Undo();
+    test.Redo();
+    test.ActiveCommands();
+
+    //пример 6: автоповтор громкости - пачка одинаковых нажатий выполняется одной командой
+    //и занимает одну запись истории, отмена снимает ее целиком
+    KeyId volume = test.AddKey(Key("EXP 5", VolumeUp()));
+    vector<KeyId> repeat(37, volume);
+    test.PressBatch(repeat.data(), repeat.size());
+    test.ActiveCommands();
+    test.Undo();
+
+    //пример 7: запись макроса, сохранение в файл и привязка к клавише
+    test.StartRecording();
+    test.PressKey("EXP 1");
+    test.PressKey("EXP 2");
+    Macro recorded = test.StopRecording();
+    recorded.Save("macro.kmc");
+    auto loaded = make_shared<Macro>(Macro::Load("macro.kmc"));
+    cout << "Macro: " << loaded->Events() << " events, " << loaded->Bytes() << " bytes" << endl;
+    test.AddKey(Key("MACRO", MacroCommand(test, loaded)));
+    test.PressKey("MACRO");
+    test.Play(loaded, ReplayMode::Scaled, 10); //в 10 раз медленнее записи
+    test.Drain();
+
+    //пример 8: журнал на диске и восстановление после перезапуска
+    remove("keyboard.kjl");
+    {
+        Journal journal("keyboard.kjl");
+        KeyBoard before;
+        before.AddKey(Key("EXP 1", SpeedUp()));
+        before.AddKey(Key("EXP 2", VolumeDown()));
+        before.AttachJournal(&journal);
+        before.PressKey("EXP 1");
+        before.PressKey("EXP 2");
+        before.Undo();
+    } //журнал дописывается при закрытии
+    KeyBoard after; //"перезапуск": те же клавиши в том же порядке
+    after.AddKey(Key("EXP 1", SpeedUp()));
+    after.AddKey(Key("EXP 2", VolumeDown()));
+    size_t recovered = after.Recover("keyboard.kjl");
+    cout << "Recovered records: " << recovered << endl;
+    after.ActiveCommands();
+
+    //пример 9: сочетания и последовательности
+    KeyBoard editor;
+    editor.AddKey(Key("Ctrl+Shift+V", PressCommand()));
+    editor.AddKey(Key("g", SpeedDown()));
+    editor.AddKey(Key("g, g", SpeedUp())); //последовательность - через запятую
+    editor.Feed("Shift+Ctrl+V"); //порядок модификаторов не важен
+    editor.Feed("g");
+    editor.Feed("g"); //"g, g" - срабатывает сразу
+    editor.Feed("g"); //"g" - ждет продолжения, по таймауту срабатывает короткая привязка
+    editor.Drain();
+
+    //пример 10: долгая команда-корутина; отмена прерывает ее на середине
+    KeyBoard mixer;
+    mixer.AddKey(Key("RAMP", VolumeRamp(10, chrono::milliseconds(50))));
+    mixer.PressKey("RAMP");
+    mixer.PressKey("RAMP"); //вторая команда идет параллельно первой
+    this_thread::sleep_for(chrono::milliseconds(120));
+    mixer.Poll();
+    mixer.Undo(); //вторая еще выполняется - прерывается
+    mixer.Drain();
+
+    //отчет в JSON (для сбора внешними инструментами)
+    test.Report(cout, KeyBoard::ReportFormat::Json);
+
+    //пустая история: отмена ничего не ломает
+    KeyBoard empty(4);
+    empty.Undo();
+}
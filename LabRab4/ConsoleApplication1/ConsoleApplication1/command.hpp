@@ -0,0 +1,269 @@
+﻿#pragma once
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <variant>
+#include <type_traits>
+#include "coroutine.hpp"
+using namespace std;
+
+//класс команды
+class Command //класс родитель
+{
+protected:
+    string m_name;
+    bool m_undo_flag = false; //флажок для функции отмены
+public:
+    Command() { m_name = "Command"; };
+    virtual ~Command() = default; //деструктор
+
+    // virtual значит, что функция может быть переопределена в потомках
+    virtual void Activation() {};
+    string GetName() { return m_name; };    //геттер
+    virtual void Undo() {};                 //команда отмены
+
+    //объединенное срабатывание: команда, повторенная times раз подряд (см. CoalesceRule)
+    virtual void ActivateTimes(uint32_t times) { for (uint32_t n = 0; n < times; n++) { Activation(); } }
+    virtual void UndoTimes(uint32_t times) { for (uint32_t n = 0; n < times; n++) { Undo(); } }
+
+    //состояние команды до выполнения - сохраняется в истории (у простых команд его нет)
+    virtual uint64_t Snapshot() const { return 0; }
+    //отмена times срабатываний с возвратом к сохраненному состоянию; по умолчанию - обычная отмена
+    virtual void Restore(uint64_t, uint32_t times) { UndoTimes(times); }
+
+    //долгие команды (см. AsyncCommand) выполняются корутиной Run вместо Activation
+    virtual bool IsAsync() const { return false; }
+    virtual CommandTask Run() { Activation(); co_return; }
+};
+
+//родитель для команд с паузами и несколькими шагами: переопределяется Run, внутри
+//которого можно co_await Delay(...) и co_await других корутин. Отмена (Undo клавиши)
+//прерывает команду, если она еще выполняется
+class AsyncCommand : public Command
+{
+public:
+    AsyncCommand() : Command() { m_name = "AsyncCommand"; };
+    bool IsAsync() const override { return true; }
+    void Activation() override {}
+};
+
+//правило объединения для команд типа T: сколько подряд идущих срабатываний одной клавиши
+//можно слить в одно (1 - не объединять). Для своих команд правило задается специализацией
+template <typename T>
+struct CoalesceRule
+{
+    static constexpr uint32_t max_merge = 1;
+};
+
+//печать объединенного срабатывания: "Volume Level Increased x37"
+inline void PrintTimes(const char* text, uint32_t times)
+{
+    cout << text;
+    if (times > 1) { cout << " x" << times; }
+    cout << endl;
+}
+
+//классы-потомки
+class SpeedUp final : public Command //команда увеличения скорости (с наследованием класса команда)
+{
+public:
+    SpeedUp() : Command() { m_name = "Speed up"; };
+
+    //override для переопределения функций
+    void Activation() override { cout << "Volume Speed Increased" << endl; }
+    void ActivateTimes(uint32_t times) override { PrintTimes("Volume Speed Increased", times); }
+    void Undo() override { m_undo_flag = true; }    //команда отмены
+};
+
+class SpeedDown final : public Command //команда уменьшения скорости (с наследованием класса команда)
+{
+public:
+    SpeedDown() : Command() { m_name = "Speed down"; };
+
+    //override для переопределения функций
+    void Activation() override { cout << "Volume Speed Decreased" << endl; }
+    void ActivateTimes(uint32_t times) override { PrintTimes("Volume Speed Decreased", times); }
+    void Undo() override { m_undo_flag = true; }    //команда отмены 
+};
+
+class VolumeUp final : public Command //команда увеличения громкости (с наследованием класса команда)
+{
+public:
+    VolumeUp() : Command() { m_name = "Volume up"; };
+
+    //override для переопределения функций
+    void Activation() override { cout << "Volume Level Increased" << endl; }
+    void ActivateTimes(uint32_t times) override { PrintTimes("Volume Level Increased", times); }
+    void Undo() override { m_undo_flag = true; }    //команда отмены
+};
+
+class VolumeDown final : public Command //команда уменьшения громкости (с наследованием класса команда)
+{
+public:
+    VolumeDown() : Command() { m_name = "Volume down"; };
+
+    //override для переопределения функций
+    void Activation() override { cout << "Volume Level Decreased" << endl; }
+    void ActivateTimes(uint32_t times) override { PrintTimes("Volume Level Decreased", times); }
+    void Undo() override { m_undo_flag = true; }    //команда отмены
+};
+
+class PressCommand final : public Command //команда активации (с наследованием класса команда)
+{
+public:
+    PressCommand() : Command() { m_name = "PressCommand"; };
+
+    //override для переопределения функций
+    void Activation() override { cout << "Command activated:" << m_name << endl; }
+    void Undo() override //команда отмены
+    {
+        cout << "Undo: " << m_name << endl;
+        m_undo_flag = true;
+    }
+};
+
+//повторы скорости и громкости сливаются (автоповтор клавиши), нажатие - нет
+template <> struct CoalesceRule<SpeedUp> { static constexpr uint32_t max_merge = 1000; };
+template <> struct CoalesceRule<SpeedDown> { static constexpr uint32_t max_merge = 1000; };
+template <> struct CoalesceRule<VolumeUp> { static constexpr uint32_t max_merge = 1000; };
+template <> struct CoalesceRule<VolumeDown> { static constexpr uint32_t max_merge = 1000; };
+
+//пользовательская команда (любой потомок Command), хранимая по значению во встроенном буфере:
+//без выделения памяти, вызовы - через виртуальные функции самой команды
+class InlineCommand
+{
+public:
+    static constexpr size_t Capacity = 96; //байт под объект команды
+
+private:
+    struct Ops
+    {
+        Command* (*get)(void*);
+        void (*copy)(void*, const void*);
+        void (*move)(void*, void*);
+        void (*destroy)(void*);
+        uint32_t max_merge; //из CoalesceRule<T>
+    };
+
+    template <typename T>
+    static constexpr Ops OpsFor = {
+        [](void* p) -> Command* { return static_cast<T*>(p); },
+        [](void* dst, const void* src) { ::new (dst) T(*static_cast<const T*>(src)); },
+        [](void* dst, void* src) { ::new (dst) T(std::move(*static_cast<T*>(src))); },
+        [](void* p) { static_cast<T*>(p)->~T(); },
+        CoalesceRule<T>::max_merge
+    };
+
+    alignas(max_align_t) unsigned char m_buf[Capacity];
+    const Ops* m_ops = nullptr;
+
+public:
+    template <typename T, typename D = decay_t<T>>
+        requires is_base_of_v<Command, D>
+    InlineCommand(T&& command)
+    {
+        static_assert(sizeof(D) <= Capacity && alignof(D) <= alignof(max_align_t), "Команда не помещается во встроенный буфер");
+        ::new (m_buf) D(forward<T>(command));
+        m_ops = &OpsFor<D>;
+    }
+
+    InlineCommand(const InlineCommand& other) : m_ops(other.m_ops) { m_ops->copy(m_buf, other.m_buf); }
+    InlineCommand(InlineCommand&& other) noexcept : m_ops(other.m_ops) { m_ops->move(m_buf, other.m_buf); }
+
+    InlineCommand& operator=(const InlineCommand& other)
+    {
+        if (this != &other)
+        {
+            m_ops->destroy(m_buf);
+            m_ops = other.m_ops;
+            m_ops->copy(m_buf, other.m_buf);
+        }
+        return *this;
+    }
+
+    InlineCommand& operator=(InlineCommand&& other) noexcept
+    {
+        if (this != &other)
+        {
+            m_ops->destroy(m_buf);
+            m_ops = other.m_ops;
+            m_ops->move(m_buf, other.m_buf);
+        }
+        return *this;
+    }
+
+    ~InlineCommand() { m_ops->destroy(m_buf); }
+
+    Command& Get() { return *m_ops->get(m_buf); }
+    const Command& Get() const { return *m_ops->get(const_cast<unsigned char*>(m_buf)); }
+
+    void Activation() { Get().Activation(); }
+    void Undo() { Get().Undo(); }
+    void ActivateTimes(uint32_t times) { Get().ActivateTimes(times); }
+    void UndoTimes(uint32_t times) { Get().UndoTimes(times); }
+    uint64_t Snapshot() const { return Get().Snapshot(); }
+    void Restore(uint64_t state, uint32_t times) { Get().Restore(state, times); }
+    uint32_t MaxMerge() const { return m_ops->max_merge; }
+    bool IsAsync() const { return Get().IsAsync(); }
+    CommandTask Run() { return Get().Run(); }
+    string GetName() { return Get().GetName(); }
+};
+
+//команда клавиши по значению. Известные команды лежат в variant и вызываются напрямую
+//(классы final - вызов без виртуальной таблицы), остальные - в InlineCommand
+class CommandHolder
+{
+private:
+    using Storage = variant<SpeedUp, SpeedDown, VolumeUp, VolumeDown, PressCommand, InlineCommand>;
+    Storage m_command;
+
+    template <typename T>
+    static constexpr bool IsBuiltin = is_same_v<T, SpeedUp> || is_same_v<T, SpeedDown> || is_same_v<T, VolumeUp>
+        || is_same_v<T, VolumeDown> || is_same_v<T, PressCommand>;
+
+public:
+    template <typename T, typename D = decay_t<T>>
+        requires is_base_of_v<Command, D> && IsBuiltin<D>
+    CommandHolder(T&& command) : m_command(in_place_type<D>, forward<T>(command)) {}
+
+    template <typename T, typename D = decay_t<T>>
+        requires is_base_of_v<Command, D> && (!IsBuiltin<D>)
+    CommandHolder(T&& command) : m_command(in_place_type<InlineCommand>, forward<T>(command)) {}
+
+    void Activation() { visit([](auto& c) { c.Activation(); }, m_command); }
+    void Undo() { visit([](auto& c) { c.Undo(); }, m_command); }
+    void ActivateTimes(uint32_t times) { visit([times](auto& c) { c.ActivateTimes(times); }, m_command); }
+    uint64_t Snapshot() const { return visit([](const auto& c) { return c.Snapshot(); }, m_command); }
+    void Restore(uint64_t state, uint32_t times) { visit([=](auto& c) { c.Restore(state, times); }, m_command); }
+
+    //сколько срабатываний можно объединить (правило типа команды)
+    uint32_t MaxMerge() const
+    {
+        return visit([](const auto& c) -> uint32_t
+            {
+                using C = decay_t<decltype(c)>;
+                if constexpr (is_same_v<C, InlineCommand>) { return c.MaxMerge(); }
+                else { return CoalesceRule<C>::max_merge; }
+            }, m_command);
+    }
+    string GetName() { return visit([](auto& c) { return c.GetName(); }, m_command); }
+
+    bool IsAsync() const { return visit([](const auto& c) { return c.IsAsync(); }, m_command); }
+    CommandTask Run() { return visit([](auto& c) { return c.Run(); }, m_command); }
+
+    //имя типа по номеру из TypeIndex
+    static const char* TypeName(uint32_t index)
+    {
+        static const char* names[] = { "SpeedUp", "SpeedDown", "VolumeUp", "VolumeDown", "PressCommand", "Custom" };
+        return index < variant_size_v<Storage> ? names[index] : "Unknown";
+    }
+
+    //номер типа команды (порядок в variant; пользовательские - последний)
+    uint32_t TypeIndex() const { return uint32_t(m_command.index()); }
+
+    //пользовательская ли команда (через InlineCommand)
+    bool IsInline() const { return holds_alternative<InlineCommand>(m_command); }
+};
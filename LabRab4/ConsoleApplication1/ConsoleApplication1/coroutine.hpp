@@ -0,0 +1,195 @@
+﻿#pragma once
+#include <coroutine>
+#include <exception>
+#include <unordered_map>
+#include <memory>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#include "scheduler.hpp"
+using namespace std;
+
+class CoExecutor;
+
+//общее состояние дерева корутин одной команды: где она ждет и не отменена ли
+struct TaskRecord
+{
+    CoExecutor* m_executor = nullptr;
+    uint64_t m_id = 0;
+    TimerWheel::TimerId m_timer = 0;    //таймер, на котором сейчас стоит команда
+    bool m_running = false;             //команда сейчас выполняется (отмену откладываем)
+    bool m_cancelled = false;
+};
+
+//корутина команды: Activation, которая может ждать таймеры (co_await Delay(...))
+//и другие корутины (co_await Child()). Запускается лениво - через CoExecutor::Spawn или co_await
+class CommandTask
+{
+public:
+    struct promise_type
+    {
+        TaskRecord* m_record = nullptr;
+        coroutine_handle<> m_continuation;  //родитель, которого разбудить по завершении
+        exception_ptr m_error;
+
+        CommandTask get_return_object() { return CommandTask(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> h) noexcept
+            {
+                coroutine_handle<> next = h.promise().m_continuation;
+                return next ? next : noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { m_error = current_exception(); }
+    };
+
+private:
+    coroutine_handle<promise_type> m_handle;
+
+    friend class CoExecutor;
+
+public:
+    explicit CommandTask(coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    CommandTask(CommandTask&& other) noexcept : m_handle(exchange(other.m_handle, {})) {}
+    CommandTask& operator=(CommandTask&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle) { m_handle.destroy(); }
+            m_handle = exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    CommandTask(const CommandTask&) = delete;
+    CommandTask& operator=(const CommandTask&) = delete;
+    ~CommandTask() { if (m_handle) { m_handle.destroy(); } }
+
+    //co_await другой корутины: она выполняется в том же дереве (общая отмена) и будит родителя
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<promise_type> parent)
+    {
+        m_handle.promise().m_record = parent.promise().m_record;
+        m_handle.promise().m_continuation = parent;
+        return m_handle;
+    }
+    void await_resume()
+    {
+        if (m_handle.promise().m_error) { rethrow_exception(m_handle.promise().m_error); }
+    }
+};
+
+//однопоточный исполнитель корутин поверх колеса таймеров: тысячи команд ждут
+//одновременно, не занимая потоков; продвигаются там же, где крутится колесо (KeyBoard::Poll)
+class CoExecutor
+{
+private:
+    struct Root
+    {
+        coroutine_handle<CommandTask::promise_type> m_handle;
+        unique_ptr<TaskRecord> m_record;
+    };
+
+    TimerWheel& m_wheel;
+    unordered_map<uint64_t, Root> m_tasks;
+    uint64_t m_next_id = 1;
+
+    //удалить завершенную или отмененную команду
+    void Reap(uint64_t id)
+    {
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end()) { return; }
+        Root& root = it->second;
+        if (!root.m_handle.done() && !root.m_record->m_cancelled) { return; }
+        m_wheel.Cancel(root.m_record->m_timer);
+        exception_ptr error = root.m_handle.done() ? root.m_handle.promise().m_error : nullptr;
+        root.m_handle.destroy(); //вложенные корутины живут в кадре корня и уничтожаются вместе с ним
+        m_tasks.erase(it);
+        if (error) { rethrow_exception(error); }
+    }
+
+public:
+    explicit CoExecutor(TimerWheel& wheel) : m_wheel(wheel) {}
+
+    ~CoExecutor()
+    {
+        for (auto& task : m_tasks)
+        {
+            m_wheel.Cancel(task.second.m_record->m_timer);
+            task.second.m_handle.destroy();
+        }
+    }
+
+    CoExecutor(const CoExecutor&) = delete;
+    CoExecutor& operator=(const CoExecutor&) = delete;
+
+    TimerWheel& Wheel() { return m_wheel; }
+
+    //запустить команду; выполняется до первого ожидания. Возвращает номер (0 - уже завершилась)
+    uint64_t Spawn(CommandTask task)
+    {
+        uint64_t id = m_next_id++;
+        Root root{ exchange(task.m_handle, {}), make_unique<TaskRecord>() };
+        root.m_record->m_executor = this;
+        root.m_record->m_id = id;
+        root.m_handle.promise().m_record = root.m_record.get();
+        auto it = m_tasks.emplace(id, move(root)).first;
+        Resume(id, it->second.m_handle);
+        return m_tasks.count(id) != 0 ? id : 0;
+    }
+
+    //продолжить корутину команды id (вызывается таймером). Команду могли отменить уже
+    //после того, как колесо забрало ее таймер (раньше в той же пачке) - тогда ничего не делаем
+    void Resume(uint64_t id, coroutine_handle<> handle)
+    {
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end()) { return; }
+        TaskRecord* record = it->second.m_record.get();
+        record->m_timer = 0;
+        record->m_running = true;
+        handle.resume();
+        record->m_running = false;
+        Reap(id);
+    }
+
+    //отмена команды в полете; false, если она уже завершилась
+    bool Cancel(uint64_t id)
+    {
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end()) { return false; }
+        it->second.m_record->m_cancelled = true;
+        if (!it->second.m_record->m_running) { Reap(id); } //иначе - по возвращении из resume
+        return true;
+    }
+
+    bool IsRunning(uint64_t id) const { return m_tasks.count(id) != 0; }
+    size_t Running() const { return m_tasks.size(); }
+};
+
+//ожидание внутри команды: co_await Delay(200ms). Поток не блокируется - корутина
+//встает на колесо таймеров и продолжится, когда колесо дойдет до срока
+struct Delay
+{
+    chrono::microseconds m_delay;
+
+    template <typename Rep, typename Period>
+    explicit Delay(chrono::duration<Rep, Period> delay) : m_delay(chrono::duration_cast<chrono::microseconds>(delay)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<CommandTask::promise_type> h)
+    {
+        //таймер держит номер команды, а не TaskRecord: запись живет, только пока жива команда
+        TaskRecord* record = h.promise().m_record;
+        CoExecutor* executor = record->m_executor;
+        uint64_t id = record->m_id;
+        record->m_timer = executor->Wheel().Schedule(m_delay, [executor, id, h] { executor->Resume(id, h); });
+    }
+    void await_resume() const noexcept {}
+};
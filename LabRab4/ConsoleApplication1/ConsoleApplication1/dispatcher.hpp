@@ -0,0 +1,159 @@
+﻿#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string_view>
+#include <cstdint>
+#include "keyboard.hpp"
+#include "eventqueue.hpp"
+using namespace std;
+
+//событие нажатия: номер клавиши и момент постановки в очередь
+struct KeyEvent
+{
+    static constexpr KeyId UndoKey = KeyId(-1); //вместо номера клавиши - отмена последней команды
+
+    KeyId m_key = 0;
+    int64_t m_posted = 0; //наносекунды steady_clock
+};
+
+//снимок счетчиков диспетчера
+struct DispatchMetrics
+{
+    size_t depth = 0;           //событий в очереди сейчас
+    uint64_t dropped = 0;       //отброшено из-за переполнения
+    uint64_t dispatched = 0;    //выполнено
+    double avg_latency_us = 0;  //среднее время от Post до выполнения команды
+    double p50_latency_us = 0, p99_latency_us = 0, p999_latency_us = 0;
+    double max_latency_us = 0;
+};
+
+//прием нажатий из любых потоков. Post кладет событие в очередь без блокировок,
+//поток диспетчера забирает события пачками и выполняет их на KeyBoard.
+//пока диспетчер запущен, KeyBoard принадлежит его потоку: клавиши добавляются до Start()
+class KeyDispatcher
+{
+private:
+    KeyBoard& m_board;
+    MpscQueue<KeyEvent> m_queue;
+    size_t m_batch;
+    vector<KeyId> m_ids;        //текущая пачка (только поток диспетчера)
+    vector<int64_t> m_posted;
+    thread m_thread;
+    atomic<bool> m_running{ false };
+
+    atomic<uint64_t> m_dropped{ 0 };
+    atomic<uint64_t> m_dispatched{ 0 };     //пишет только поток диспетчера
+    LatencyHistogram m_latency;             //от Post до выполнения, нс (пишет только поток диспетчера)
+
+    static int64_t Now() { return chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count(); }
+
+    //выполнить не больше m_batch событий одной пачкой (с объединением повторов); возвращает их число
+    size_t DrainBatch()
+    {
+        KeyEvent event;
+        size_t done = 0;
+        while (done < m_batch && m_queue.TryPop(event))
+        {
+            m_ids[done] = event.m_key;
+            m_posted[done] = event.m_posted;
+            done++;
+        }
+        if (done == 0) { return 0; }
+        //задержка события - до момента, когда выполнено именно оно, а не вся пачка
+        auto stamp = [this](size_t first, size_t count)
+            {
+                int64_t now = Now();
+                for (size_t n = first; n < first + count; n++) { m_latency.Record(uint64_t(max<int64_t>(0, now - m_posted[n]))); }
+            };
+        size_t from = 0; //нажатия между отменами идут пачками
+        for (size_t n = 0; n <= done; n++)
+        {
+            if (n < done && m_ids[n] != KeyEvent::UndoKey) { continue; }
+            m_board.PressBatch(m_ids.data() + from, n - from, [&](size_t first, size_t count) { stamp(from + first, count); });
+            if (n < done)
+            {
+                m_board.Undo();
+                stamp(n, 1);
+            }
+            from = n + 1;
+        }
+        m_dispatched.fetch_add(done, memory_order_relaxed);
+        return done;
+    }
+
+    void Run()
+    {
+        unsigned idle = 0;
+        while (m_running.load(memory_order_acquire))
+        {
+            size_t done = DrainBatch();
+            m_board.Poll(); //отложенные команды (темп, дребезг)
+            if (done > 0) { idle = 0; continue; }
+            //очередь пуста: сначала крутимся, потом уступаем процессор, потом засыпаем ненадолго
+            idle++;
+            if (idle < 64) { continue; }
+            if (idle < 128) { this_thread::yield(); continue; }
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+        while (DrainBatch() > 0) {} //события, пришедшие до остановки
+    }
+
+public:
+    KeyDispatcher(KeyBoard& board, size_t capacity = 65536, size_t batch = 256)
+        : m_board(board), m_queue(capacity), m_batch(batch), m_ids(batch), m_posted(batch) {}
+
+    ~KeyDispatcher() { Stop(); }
+
+    KeyDispatcher(const KeyDispatcher&) = delete;
+    KeyDispatcher& operator=(const KeyDispatcher&) = delete;
+
+    void Start()
+    {
+        if (m_running.exchange(true)) { return; }
+        m_thread = thread([this] { Run(); });
+    }
+
+    //остановка; события, уже стоящие в очереди, выполняются
+    void Stop()
+    {
+        if (!m_running.exchange(false)) { return; }
+        m_thread.join();
+    }
+
+    //из любого потока; false, если очередь переполнена (событие отброшено и учтено)
+    bool Post(KeyId id)
+    {
+        if (m_queue.TryPush(KeyEvent{ id, Now() })) { return true; }
+        m_dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    //отмена последней выполненной команды - в общем порядке с нажатиями
+    bool PostUndo() { return Post(KeyEvent::UndoKey); }
+
+    //по имени: событие на каждую клавишу с этим именем; false, если имя неизвестно или что-то отброшено
+    bool Post(string_view key_name)
+    {
+        const vector<KeyId>* ids = m_board.FindKeys(key_name);
+        if (ids == nullptr) { return false; }
+        bool ok = true;
+        for (KeyId id : *ids) { ok = Post(id) && ok; }
+        return ok;
+    }
+
+    DispatchMetrics Metrics() const
+    {
+        DispatchMetrics metrics;
+        metrics.depth = m_queue.Depth();
+        metrics.dropped = m_dropped.load(memory_order_relaxed);
+        metrics.dispatched = m_dispatched.load(memory_order_relaxed);
+        ProbeSummary latency = m_latency.Summary();
+        metrics.avg_latency_us = latency.mean_ns / 1000;
+        metrics.p50_latency_us = double(latency.p50_ns) / 1000;
+        metrics.p99_latency_us = double(latency.p99_ns) / 1000;
+        metrics.p999_latency_us = double(latency.p999_ns) / 1000;
+        metrics.max_latency_us = double(latency.max_ns) / 1000;
+        return metrics;
+    }
+};
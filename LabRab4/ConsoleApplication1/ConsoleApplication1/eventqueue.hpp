@@ -0,0 +1,80 @@
+﻿#pragma once
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+using namespace std;
+
+//ограниченная очередь без блокировок: писать могут многие потоки, читает один.
+//каждая ячейка хранит номер "поколения": по нему писатель видит, что ячейка свободна,
+//а читатель - что запись в ней закончена. емкость - степень двойки
+template <typename T>
+class MpscQueue
+{
+private:
+    struct Cell
+    {
+        atomic<size_t> m_seq;
+        T m_value;
+    };
+
+    vector<Cell> m_cells;
+    size_t m_mask;
+    alignas(64) atomic<size_t> m_tail{ 0 }; //следующая позиция для записи (общая для писателей)
+    alignas(64) atomic<size_t> m_head{ 0 }; //следующая позиция для чтения (меняет только читатель)
+
+public:
+    explicit MpscQueue(size_t capacity) : m_cells(capacity), m_mask(capacity - 1)
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+        {
+            throw invalid_argument("Емкость очереди должна быть степенью двойки");
+        }
+        for (size_t n = 0; n < capacity; n++) { m_cells[n].m_seq.store(n, memory_order_relaxed); }
+    }
+
+    //из любого потока; false, если очередь заполнена
+    bool TryPush(const T& value)
+    {
+        size_t pos = m_tail.load(memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            size_t seq = cell.m_seq.load(memory_order_acquire);
+            ptrdiff_t dif = ptrdiff_t(seq) - ptrdiff_t(pos);
+            if (dif == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) { break; }
+            }
+            else if (dif < 0) { return false; } //ячейка еще не прочитана - очередь полна
+            else { pos = m_tail.load(memory_order_relaxed); }
+        }
+        Cell& cell = m_cells[pos & m_mask];
+        cell.m_value = value;
+        cell.m_seq.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    //только из потока-читателя; false, если очередь пуста
+    bool TryPop(T& value)
+    {
+        size_t pos = m_head.load(memory_order_relaxed);
+        Cell& cell = m_cells[pos & m_mask];
+        if (cell.m_seq.load(memory_order_acquire) != pos + 1) { return false; }
+        value = cell.m_value;
+        cell.m_seq.store(pos + m_mask + 1, memory_order_release); //ячейка свободна для следующего круга
+        m_head.store(pos + 1, memory_order_relaxed);
+        return true;
+    }
+
+    //примерное число элементов (точное, если писатели стоят)
+    size_t Depth() const
+    {
+        size_t tail = m_tail.load(memory_order_relaxed);
+        size_t head = m_head.load(memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t Capacity() const { return m_cells.size(); }
+};
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include "registry.hpp"
+using namespace std;
+
+//запись истории: какая клавиша сработала и состояние ее команды до срабатывания
+struct HistoryEntry
+{
+    KeyId m_key = 0;
+    uint32_t m_count = 1;   //сколько срабатываний объединено в записи
+    uint64_t m_state = 0;   //снимок Command::Snapshot() до выполнения
+    uint64_t m_task = 0;    //корутина долгой команды (CoExecutor), 0 - команда обычная
+};
+
+//история отмен и повторов фиксированной емкости. Записи лежат в кольцевом буфере:
+//при переполнении самая старая перезаписывается, память после создания не растет.
+//все операции - O(1)
+class CommandHistory
+{
+private:
+    vector<HistoryEntry> m_ring;
+    size_t m_begin = 0;     //позиция самой старой записи
+    size_t m_size = 0;      //записей всего (выполненные + доступные для повтора)
+    size_t m_cursor = 0;    //выполненных записей: [0, m_cursor) можно отменить, [m_cursor, m_size) - повторить
+    uint64_t m_evicted = 0; //сколько старых записей вытеснено
+
+    HistoryEntry& Slot(size_t n) { return m_ring[(m_begin + n) % m_ring.size()]; }
+
+public:
+    explicit CommandHistory(size_t capacity = 1024) : m_ring(capacity)
+    {
+        if (capacity == 0) { throw invalid_argument("Емкость истории должна быть больше нуля"); }
+    }
+
+    //новая запись; отмененные записи после курсора больше нельзя повторить
+    void Push(const HistoryEntry& entry)
+    {
+        m_size = m_cursor;
+        if (m_size == m_ring.size()) //места нет - вытесняем самую старую
+        {
+            m_begin = (m_begin + 1) % m_ring.size();
+            m_size--;
+            m_cursor--;
+            m_evicted++;
+        }
+        Slot(m_size) = entry;
+        m_size++;
+        m_cursor++;
+    }
+
+    //последняя выполненная запись для отмены (nullptr, если отменять нечего)
+    HistoryEntry* Undo()
+    {
+        if (m_cursor == 0) { return nullptr; }
+        return &Slot(--m_cursor);
+    }
+
+    //ближайшая отмененная запись для повтора (nullptr, если повторять нечего)
+    HistoryEntry* Redo()
+    {
+        if (m_cursor == m_size) { return nullptr; }
+        return &Slot(m_cursor++);
+    }
+
+    //выполненные записи от старой к новой: At(0) .. At(Done() - 1)
+    const HistoryEntry& At(size_t n) const { return m_ring[(m_begin + n) % m_ring.size()]; }
+    size_t Done() const { return m_cursor; }
+    size_t Redoable() const { return m_size - m_cursor; }
+    size_t Capacity() const { return m_ring.size(); }
+    uint64_t Evicted() const { return m_evicted; }
+};
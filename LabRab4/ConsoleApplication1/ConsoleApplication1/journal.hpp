@@ -0,0 +1,195 @@
+﻿#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <filesystem>
+#include <system_error>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "registry.hpp"
+using namespace std;
+
+//запись журнала: фиксированные 32 байта, контрольная сумма отсекает недописанный хвост
+struct JournalRecord
+{
+    enum Kind : uint8_t { Activate = 0, Undo = 1, Redo = 2 };
+
+    int64_t m_time = 0;     //мкс от эпохи system_clock
+    KeyId m_key = 0;
+    uint32_t m_command = 0; //тип команды (CommandHolder::TypeIndex)
+    uint32_t m_count = 1;   //объединенных срабатываний
+    uint8_t m_kind = Activate;
+    uint8_t m_pad[3] = {};
+    uint32_t m_check = 0;   //FNV-1a по предыдущим полям
+    uint32_t m_reserved = 0;
+
+    uint32_t Checksum() const
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(this);
+        uint32_t h = 2166136261u;
+        for (size_t n = 0; n < offsetof(JournalRecord, m_check); n++) { h = (h ^ p[n]) * 16777619u; }
+        return h;
+    }
+};
+static_assert(sizeof(JournalRecord) == 32, "Запись журнала должна занимать 32 байта");
+
+//журнал только на дописывание с групповой фиксацией. Append лишь кладет запись в буфер
+//в памяти; фоновый поток забирает накопленное и пишет одним write + fsync, не реже чем раз
+//в latency_budget (или раньше, если буфер набрал batch_records записей)
+class Journal
+{
+private:
+    FILE* m_file = nullptr;
+    chrono::microseconds m_budget;
+    size_t m_batch;
+
+    mutex m_mutex;
+    condition_variable m_wake;      //будит писателя
+    condition_variable m_synced_cv; //будит ждущих Flush
+    vector<JournalRecord> m_pending;
+    uint64_t m_appended = 0;        //записей принято
+    uint64_t m_synced = 0;          //записей на диске
+    uint64_t m_commits = 0;         //выполнено fsync
+    bool m_stop = false;
+    bool m_flush = false;           //кто-то ждет в Flush - писать, не дожидаясь срока
+    bool m_failed = false;          //запись или fsync не удались: дальше журнал ничего не гарантирует
+    thread m_writer;
+
+    static bool SyncFile(FILE* file)
+    {
+        if (fflush(file) != 0) { return false; }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    void WriterLoop()
+    {
+        vector<JournalRecord> batch;
+        unique_lock<mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wake.wait_for(lock, m_budget, [this] { return m_stop || m_flush || m_pending.size() >= m_batch; });
+            m_flush = false;
+            if (m_pending.empty())
+            {
+                if (m_stop) { return; }
+                continue;
+            }
+            batch.swap(m_pending);
+            uint64_t upto = m_appended;
+            if (m_failed) //после ошибки хвост файла не определен - дописывать за ним нельзя
+            {
+                batch.clear();
+                continue;
+            }
+            lock.unlock();
+            bool ok = fwrite(batch.data(), sizeof(JournalRecord), batch.size(), m_file) == batch.size() && SyncFile(m_file);
+            batch.clear();
+            lock.lock();
+            if (ok)
+            {
+                m_synced = upto;
+                m_commits++;
+            }
+            else { m_failed = true; } //диск полон или ошибка ввода-вывода
+            m_synced_cv.notify_all();
+        }
+    }
+
+public:
+    //открыть журнал на дописывание; недописанный хвост (после сбоя) отрезается
+    explicit Journal(const string& path, chrono::microseconds latency_budget = chrono::milliseconds(2), size_t batch_records = 4096)
+        : m_budget(latency_budget), m_batch(batch_records)
+    {
+        vector<JournalRecord> records = Read(path);
+        error_code error;
+        uintmax_t size = filesystem::file_size(path, error);
+        uintmax_t good = uintmax_t(records.size()) * sizeof(JournalRecord);
+        if (!error && size != good) //хвост поврежден - отрезаем его на месте, целые записи не переписываются
+        {
+            filesystem::resize_file(path, good, error);
+            if (error) { throw runtime_error("Не удалось восстановить журнал " + path); }
+        }
+        m_file = fopen(path.c_str(), "ab");
+        if (m_file == nullptr) { throw runtime_error("Не удалось открыть журнал " + path); }
+        m_pending.reserve(m_batch);
+        m_writer = thread([this] { WriterLoop(); });
+    }
+
+    ~Journal()
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_writer.join();
+        fclose(m_file);
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    //добавить запись (время проставляется здесь); на диск она попадет с ближайшей группой
+    void Append(JournalRecord record)
+    {
+        record.m_time = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        record.m_check = record.Checksum();
+        bool full;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_pending.push_back(record);
+            m_appended++;
+            full = m_pending.size() == m_batch;
+        }
+        if (full) { m_wake.notify_one(); }
+    }
+
+    //дождаться, пока все принятые записи окажутся на диске; исключение, если запись не удалась
+    void Flush()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        uint64_t target = m_appended;
+        if (m_synced < target && !m_failed)
+        {
+            m_flush = true;
+            m_wake.notify_one();
+            m_synced_cv.wait(lock, [&] { return m_synced >= target || m_failed; });
+        }
+        if (m_failed) { throw runtime_error("Ошибка записи журнала: записи не сохранены на диск"); }
+    }
+
+    bool Failed() { lock_guard<mutex> lock(m_mutex); return m_failed; }
+
+    uint64_t Appended() { lock_guard<mutex> lock(m_mutex); return m_appended; }
+    uint64_t Commits() { lock_guard<mutex> lock(m_mutex); return m_commits; }
+
+    //все целые записи файла по порядку; чтение останавливается на первой испорченной
+    static vector<JournalRecord> Read(const string& path)
+    {
+        vector<JournalRecord> records;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) { return records; }
+        JournalRecord record;
+        while (fread(&record, sizeof(record), 1, file) == 1 && record.m_check == record.Checksum())
+        {
+            records.push_back(record);
+        }
+        fclose(file);
+        return records;
+    }
+};
@@ -0,0 +1,577 @@
+﻿#pragma once
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <memory>
+#include <ostream>
+#include "command.hpp"
+#include "scheduler.hpp"
+#include "registry.hpp"
+#include "history.hpp"
+#include "macro.hpp"
+#include "journal.hpp"
+#include "matcher.hpp"
+#include "metrics.hpp"
+using namespace std;
+
+//класс клавиши
+class Key
+{
+private:
+    string m_name = ""; //пустые строки
+    string m_com_name = "";
+
+    CommandHolder m_command; //команда клавиши (клавиша владеет ею по значению)
+    bool m_undo_flag = false; //флажок для отмены
+
+    bool m_async = false; //команда выполняется корутиной (AsyncCommand)
+    uint32_t m_max_merge = 1; //сколько подряд идущих нажатий можно слить в одно (CoalesceRule)
+    DispatchPolicy m_policy; //как выдавать команду (сразу, с подавлением дребезга, с темпом)
+    TimerWheel::TimerId m_timer = 0; //отложенная выдача (для Debounce)
+    Clock::time_point m_next_free{}; //раньше этого момента команду не выдавать (для Pace)
+
+    friend class KeyBoard;
+
+public:
+    Key(string name, CommandHolder command, DispatchPolicy policy = DispatchPolicy::Immediate())
+        : m_command(move(command)) //присваем значения
+    {
+        m_name = move(name);
+        m_policy = policy;
+        m_max_merge = m_command.MaxMerge();
+        m_async = m_command.IsAsync();
+    }
+
+    void Press() //команда активации
+    {
+        m_command.Activation(); //функция активации команды клавиши
+    }
+
+    void KeyUndo() //команда отмены
+    {
+        m_command.Undo(); //функция отмены команды клавиши
+    }
+
+    void Press(uint32_t times) { m_command.ActivateTimes(times); } //объединенное срабатывание
+    void KeyUndo(uint64_t state, uint32_t times) { m_command.Restore(state, times); } //отмена к сохраненному состоянию
+    uint64_t Snapshot() const { return m_command.Snapshot(); } //состояние команды для истории
+    bool IsAsync() const { return m_async; }
+    CommandTask Run() { return m_command.Run(); } //корутина долгой команды
+    uint32_t CommandType() const { return m_command.TypeIndex(); } //тип команды для журнала
+
+    const string& GetName() const { return m_name; } //геттер (без копирования строки)
+};
+
+//класс клавиатуры
+class KeyBoard
+{
+private:
+    deque <Key> m_keys{}; //клавиши; deque - адреса не меняются при добавлении (на команды ссылаются корутины)
+    CommandHistory m_history; //история для отмены и повтора
+    KeyRegistry m_registry; //имя -> номера клавиш
+    TimerWheel m_wheel; //отложенные выдачи команд
+    CoExecutor m_executor{ m_wheel }; //долгие команды (корутины) - на том же колесе
+    unique_ptr<Macro> m_recording; //идет запись макроса, если не пусто
+    Clock::time_point m_recorded_at{}; //время последнего записанного события
+    SequenceMatcher m_matcher; //сочетания и последовательности по именам клавиш
+    SequenceMatcher::State m_seq_state = SequenceMatcher::Root; //сколько последовательности уже набрано
+    TimerWheel::TimerId m_seq_timer = 0; //ожидание продолжения последовательности
+    chrono::microseconds m_seq_timeout = chrono::milliseconds(500);
+    mutable MetricsRegistry m_metrics; //задержки и счетчики срабатываний
+    Journal* m_journal = nullptr; //журнал выполненных команд (необязательный)
+    bool m_echo = true;     //сообщения отмены и повтора в консоль
+    int m_replay_depth = 0; //вложенность воспроизведения (макрос на клавише может вызвать макрос)
+    bool m_recovering = false; //идет Recover: макросы не воспроизводятся, их нажатия - в журнале
+
+    static constexpr int max_replay_depth = 8;
+
+    //запись нажатия в макрос
+    void Record(KeyId id)
+    {
+        if (!m_recording) { return; }
+        Clock::time_point now = Clock::now();
+        uint64_t delay = m_recording->Events() == 0 ? 0 : uint64_t(chrono::duration_cast<chrono::microseconds>(now - m_recorded_at).count());
+        m_recording->Append(id, delay);
+        m_recorded_at = now;
+    }
+
+    //пошаговое воспроизведение по таймерам: каждое событие ставит на колесо следующее
+    struct Replay
+    {
+        shared_ptr<const Macro> macro;
+        size_t pos = 0;
+        double scale = 1;
+        int depth = 0; //вложенность воспроизведения на момент Play: шаги из таймеров идут на ней же
+    };
+
+    //возвращает прежнюю вложенность воспроизведения при выходе из области (и при исключении)
+    struct DepthGuard
+    {
+        int& m_depth;
+        int m_saved;
+        DepthGuard(int& depth, int value) : m_depth(depth), m_saved(depth) { m_depth = value; }
+        ~DepthGuard() { m_depth = m_saved; }
+    };
+
+    void ReplayStep(shared_ptr<Replay> replay)
+    {
+        //шаг из таймера выполняется на вложенности своего Play, иначе макрос, нажимающий
+        //свою же клавишу с паузой, перезапускался бы бесконечно мимо max_replay_depth
+        DepthGuard depth(m_replay_depth, replay->depth);
+        KeyId key;
+        uint64_t delay;
+        size_t pos = replay->pos;
+        if (!replay->macro->Next(pos, key, delay)) { return; }
+        replay->pos = pos;
+        PressKey(key);
+        //события без паузы выполняются сразу, до первой паузы
+        while (replay->macro->Next(pos, key, delay))
+        {
+            auto wait = chrono::microseconds(int64_t(double(delay) * replay->scale));
+            if (wait.count() > 0)
+            {
+                m_wheel.Schedule(wait, [this, replay] { ReplayStep(replay); });
+                return;
+            }
+            replay->pos = pos;
+            PressKey(key);
+        }
+    }
+
+    //выполнить команду клавиши (times объединенных нажатий) и записать в историю одной записью.
+    //start - начало замера у точки входа (0 - событие не попало в выборку)
+    void Fire(size_t x, uint32_t times, int64_t start)
+    {
+        if (start != 0) { start = MetricsRegistry::Now(); } //Activation - только выполнение команды
+        uint64_t state = m_keys[x].Snapshot();
+        uint64_t task = 0;
+        if (m_keys[x].IsAsync()) { task = m_executor.Spawn(m_keys[x].Run()); }
+        else if (times == 1) { m_keys[x].Press(); }
+        else { m_keys[x].Press(times); }
+        int64_t activated = start != 0 ? MetricsRegistry::Now() : 0;
+        m_history.Push(HistoryEntry{ KeyId(x), times, state, task });
+        WriteJournal(JournalRecord::Activate, KeyId(x), times);
+        if (start != 0)
+        {
+            m_metrics.Record(Probe::Activation, start, activated);
+            m_metrics.Record(Probe::Logging, activated, MetricsRegistry::Now());
+        }
+        if (m_metrics.Enabled()) { m_metrics.CountKey(KeyId(x), m_keys[x].CommandType()); }
+    }
+
+    //начало замера времени (0 - замеры выключены или событие не попало в выборку).
+    //решение о выборке принимается один раз на событие - в точке входа или в таймере
+    int64_t Stamp() const { return m_metrics.Start(); }
+
+    //выдать все клавиши, привязанные к состоянию автомата
+    void FireState(SequenceMatcher::State state)
+    {
+        for (KeyId id : m_matcher.Keys(state)) { Dispatch(id, Stamp()); }
+    }
+
+    //переход автомата в next. Если дальше идти некуда - привязка срабатывает сразу;
+    //если есть и привязка, и более длинные ("g" и "g, g") - ждем продолжения до таймаута
+    void Enter(SequenceMatcher::State next)
+    {
+        m_wheel.Cancel(m_seq_timer);
+        m_seq_timer = 0;
+        if (!m_matcher.HasChildren(next))
+        {
+            m_seq_state = SequenceMatcher::Root;
+            FireState(next);
+            return;
+        }
+        m_seq_state = next;
+        m_seq_timer = m_wheel.Schedule(m_seq_timeout, [this]
+            {
+                m_seq_timer = 0;
+                SequenceMatcher::State pending = m_seq_state;
+                m_seq_state = SequenceMatcher::Root;
+                FireState(pending); //продолжения не было - срабатывает короткая привязка (если есть)
+            });
+    }
+
+    //запись в журнал, если он подключен
+    void WriteJournal(uint8_t kind, KeyId id, uint32_t times)
+    {
+        if (m_journal == nullptr) { return; }
+        JournalRecord record;
+        record.m_key = id;
+        record.m_command = m_keys[id].CommandType();
+        record.m_count = times;
+        record.m_kind = kind;
+        m_journal->Append(record);
+    }
+
+    //выдача по политике клавиши; вызывающий поток никогда не ждет
+    void Dispatch(size_t x, int64_t start)
+    {
+        Record(KeyId(x));
+        Key& key = m_keys[x];
+        switch (key.m_policy.kind)
+        {
+        case DispatchPolicy::Kind::Immediate:
+            Fire(x, 1, start);
+            break;
+        case DispatchPolicy::Kind::Debounce: //каждое нажатие отодвигает выдачу
+            m_wheel.Cancel(key.m_timer);
+            key.m_timer = m_wheel.Schedule(key.m_policy.interval, [this, x] { m_keys[x].m_timer = 0; Fire(x, 1, Stamp()); });
+            break;
+        case DispatchPolicy::Kind::Pace:
+        {
+            Clock::time_point now = Clock::now();
+            if (now >= key.m_next_free)
+            {
+                key.m_next_free = now + key.m_policy.interval;
+                Fire(x, 1, start);
+            }
+            else //занимаем следующее свободное окно
+            {
+                auto delay = chrono::duration_cast<chrono::microseconds>(key.m_next_free - now);
+                key.m_next_free += key.m_policy.interval;
+                m_wheel.Schedule(delay, [this, x] { Fire(x, 1, Stamp()); });
+            }
+            break;
+        }
+        }
+    }
+
+public:
+    explicit KeyBoard(size_t history_capacity = 1024) : m_history(history_capacity) {}
+
+    //таймеры и исполнитель корутин держат this и ссылку на m_wheel - объект не копируется и не переносится
+    KeyBoard(const KeyBoard&) = delete;
+    KeyBoard& operator=(const KeyBoard&) = delete;
+    KeyBoard(KeyBoard&&) = delete;
+    KeyBoard& operator=(KeyBoard&&) = delete;
+
+    //заполняем вектор и индекс; возвращает номер клавиши
+    KeyId AddKey(Key key)
+    {
+        KeyId id = KeyId(m_keys.size());
+        m_registry.Add(key.GetName(), id);
+        m_matcher.Add(key.GetName(), id); //автомат достраивается, а не собирается заново
+        m_keys.push_back(move(key));
+        return id;
+    }
+
+    //нажатие по имени: поиск в хеш-таблице, выдаются все клавиши с этим именем
+    void PressKey(string_view key_name)
+    {
+        int64_t start = Stamp();
+        const vector<KeyId>* ids = m_registry.Find(key_name);
+        if (start != 0) { m_metrics.Record(Probe::Lookup, start, MetricsRegistry::Now()); }
+        if (ids == nullptr) { cout << "[Unable key]" << endl; return; } //если нет - ошибка
+        for (KeyId id : *ids) { Dispatch(id, start); }
+        if (start != 0) { m_metrics.Record(Probe::PressKey, start, MetricsRegistry::Now()); }
+    }
+
+    //событие клавиатуры для сочетаний и последовательностей: "Ctrl+Shift+V", "g", ...
+    //каждое событие - один переход автомата
+    void Feed(string_view chord)
+    {
+        SequenceMatcher::State next;
+        if (m_matcher.Step(m_seq_state, chord, next)) { Enter(next); return; }
+        if (m_seq_state != SequenceMatcher::Root) //последовательность прервана
+        {
+            m_wheel.Cancel(m_seq_timer);
+            m_seq_timer = 0;
+            SequenceMatcher::State pending = m_seq_state;
+            m_seq_state = SequenceMatcher::Root;
+            FireState(pending); //набранная короткая привязка срабатывает
+            if (m_matcher.Step(SequenceMatcher::Root, chord, next)) { Enter(next); return; }
+        }
+        cout << "[Unable key]" << endl;
+    }
+
+    //сколько ждать продолжения последовательности
+    void SetSequenceTimeout(chrono::microseconds timeout) { m_seq_timeout = timeout; }
+
+    //нажатие по номеру, полученному из AddKey/FindKeys
+    void PressKey(KeyId id)
+    {
+        if (id >= m_keys.size()) { cout << "[Unable key]" << endl; return; }
+        int64_t start = Stamp();
+        Dispatch(id, start);
+        if (start != 0) { m_metrics.Record(Probe::PressKey, start, MetricsRegistry::Now()); }
+    }
+
+    //пачка нажатий (например, из очереди диспетчера). Подряд идущие нажатия одной клавиши
+    //сливаются в одно срабатывание, если это разрешает правило ее команды и политика - Immediate
+    void PressBatch(const KeyId* ids, size_t count)
+    {
+        PressBatch(ids, count, [](size_t, size_t) {});
+    }
+
+    //то же; done(первое, сколько) вызывается сразу после того, как эти нажатия выполнены
+    //(для слитых повторов - один раз на серию), например чтобы замерить задержку каждого
+    template <typename F>
+    void PressBatch(const KeyId* ids, size_t count, F done)
+    {
+        for (size_t n = 0; n < count;)
+        {
+            KeyId id = ids[n];
+            if (id >= m_keys.size()) { cout << "[Unable key]" << endl; done(n, 1); n++; continue; }
+            Key& key = m_keys[id];
+            if (key.m_policy.kind != DispatchPolicy::Kind::Immediate || key.m_max_merge <= 1)
+            {
+                Dispatch(id, Stamp());
+                done(n, 1);
+                n++;
+                continue;
+            }
+            uint32_t run = 1;
+            while (n + run < count && ids[n + run] == id && run < key.m_max_merge) { run++; }
+            for (uint32_t r = 0; r < run; r++) { Record(id); }
+            Fire(id, run, Stamp());
+            done(n, run);
+            n += run;
+        }
+    }
+
+    //начать запись нажатий в макрос (timed - сохранять паузы между нажатиями)
+    void StartRecording(bool timed = true)
+    {
+        m_recording = make_unique<Macro>(timed);
+    }
+
+    //закончить запись и получить макрос
+    Macro StopRecording()
+    {
+        if (!m_recording) { throw logic_error("Запись макроса не начата"); }
+        Macro macro = move(*m_recording);
+        m_recording.reset();
+        return macro;
+    }
+
+    bool IsRecording() const { return m_recording != nullptr; }
+
+    //воспроизведение макроса. Fast выполняет все сразу пачками; RealTime и Scaled ставят
+    //события на колесо таймеров и не блокируют вызывающего (нужен Poll/Drain или диспетчер)
+    void Play(shared_ptr<const Macro> macro, ReplayMode mode = ReplayMode::Fast, double scale = 1)
+    {
+        //вложенные нажатия макроса пишутся в журнал своими записями (в том числе отложенные,
+        //вперемешку с другими событиями); при восстановлении они и применяются, а запись клавиши
+        //макроса только восстанавливает ее место в истории - иначе каждое нажатие выполнилось бы дважды
+        if (m_recovering) { return; }
+        if (m_replay_depth >= max_replay_depth) { cout << "[Macro recursion]" << endl; return; }
+        m_replay_depth++;
+        if (mode == ReplayMode::Fast)
+        {
+            vector<KeyId> chunk;
+            chunk.reserve(4096);
+            macro->ForEach([&](KeyId key, uint64_t)
+                {
+                    chunk.push_back(key);
+                    if (chunk.size() == 4096) { PressBatch(chunk.data(), chunk.size()); chunk.clear(); }
+                });
+            PressBatch(chunk.data(), chunk.size());
+        }
+        else
+        {
+            auto replay = make_shared<Replay>();
+            replay->macro = move(macro);
+            replay->scale = mode == ReplayMode::RealTime ? 1 : scale;
+            replay->depth = m_replay_depth;
+            ReplayStep(replay);
+        }
+        m_replay_depth--;
+    }
+
+    //прежний вариант с перебором всех клавиш (оставлен для сравнения в замерах)
+    void PressKeyLinear(string_view key_name)
+    {
+        bool flag = false;
+        for (size_t x = 0; x < m_keys.size(); x++)
+        {
+            if (m_keys[x].GetName() == key_name)  // проверяем, есть ли клавиша с именем key_name в векторе m_keys
+            {
+                Dispatch(x, Stamp());
+                flag = true;
+            }
+        }
+        if (flag == false) { cout << "[Unable key]" << endl; } //если нет - ошибка
+    }
+
+    //номера клавиш с данным именем (nullptr, если таких нет)
+    const vector<KeyId>* FindKeys(string_view key_name) const { return m_registry.Find(key_name); }
+
+    size_t KeyCount() const { return m_keys.size(); }
+
+    //выполнить отложенные команды, срок которых наступил; возвращает их число
+    size_t Poll() { return m_wheel.Advance(); }
+
+    //дождаться выполнения всех отложенных команд (для завершения программы)
+    void Drain()
+    {
+        while (m_wheel.Pending() > 0)
+        {
+            this_thread::sleep_until(m_wheel.NextDeadline());
+            m_wheel.Advance();
+        }
+    }
+
+    size_t PendingCommands() const { return m_wheel.Pending(); }
+    size_t RunningCommands() const { return m_executor.Running(); } //долгие команды в полете
+
+    //отмена последнего выполненного нажатия; false, если отменять нечего
+    bool Undo()
+    {
+        int64_t start = Stamp();
+        HistoryEntry* entry = m_history.Undo();
+        if (entry == nullptr)
+        {
+            if (m_echo) { cout << "[Nothing to undo]" << endl; }
+            return false;
+        }
+        Key& key = m_keys[entry->m_key];
+        if (m_echo) { cout << "[Undo command]: " << key.GetName() << endl; } //сообщение об отмене  команды
+        if (entry->m_task != 0 && m_executor.Cancel(entry->m_task) && m_echo) { cout << "[Cancelled in flight]" << endl; }
+        int64_t undo_start = start != 0 ? MetricsRegistry::Now() : 0;
+        key.KeyUndo(entry->m_state, entry->m_count); //отмена команды (объединенная запись - целиком)
+        if (start != 0) { m_metrics.Record(Probe::KeyUndo, undo_start, MetricsRegistry::Now()); }
+        WriteJournal(JournalRecord::Undo, entry->m_key, entry->m_count);
+        if (start != 0) { m_metrics.Record(Probe::Undo, start, MetricsRegistry::Now()); }
+        return true;
+    }
+
+    //повтор последнего отмененного нажатия; false, если повторять нечего
+    bool Redo()
+    {
+        HistoryEntry* entry = m_history.Redo();
+        if (entry == nullptr)
+        {
+            if (m_echo) { cout << "[Nothing to redo]" << endl; }
+            return false;
+        }
+        Key& key = m_keys[entry->m_key];
+        if (m_echo) { cout << "[Redo command]: " << key.GetName() << endl; }
+        entry->m_state = key.Snapshot();
+        if (key.IsAsync()) { entry->m_task = m_executor.Spawn(key.Run()); }
+        else { key.Press(entry->m_count); }
+        WriteJournal(JournalRecord::Redo, entry->m_key, entry->m_count);
+        return true;
+    }
+
+    //сообщения "[Undo command]" и т.п. (выключаются для замеров)
+    void SetEcho(bool echo) { m_echo = echo; }
+
+    const CommandHistory& History() const { return m_history; }
+
+    //подключить журнал (nullptr - отключить); журнал должен жить дольше клавиатуры
+    void AttachJournal(Journal* journal) { m_journal = journal; }
+
+    //восстановление после перезапуска: команды из журнала выполняются заново, история
+    //отмен восстанавливается. Клавиши должны быть добавлены в том же порядке, что и при записи.
+    //возвращает число примененных записей
+    size_t Recover(const string& path)
+    {
+        Journal* attached = m_journal;
+        m_journal = nullptr; //повторное выполнение не пишется в журнал второй раз
+        m_recovering = true;
+        size_t applied = 0;
+        for (const JournalRecord& record : Journal::Read(path))
+        {
+            if (record.m_key >= m_keys.size() || m_keys[record.m_key].CommandType() != record.m_command)
+            {
+                cout << "[Journal mismatch at record " << applied << "]" << endl;
+                break;
+            }
+            switch (record.m_kind)
+            {
+            case JournalRecord::Activate: Fire(record.m_key, record.m_count, 0); break;
+            case JournalRecord::Undo: Undo(); break;
+            case JournalRecord::Redo: Redo(); break;
+            }
+            applied++;
+        }
+        m_journal = attached;
+        m_recovering = false;
+        return applied;
+    }
+
+    //замеры задержек и счетчики (можно выключить - тогда время не снимается)
+    MetricsRegistry& Metrics() { return m_metrics; }
+
+    enum class ReportFormat { Text, Json };
+
+    //отчет: выполненные команды, задержки по точкам замера, срабатывания клавиш и типов команд
+    void Report(ostream& os, ReportFormat format = ReportFormat::Text) const
+    {
+        bool json = format == ReportFormat::Json;
+        os << (json ? "{\"active_commands\": [" : "Active commands:\n");
+        for (size_t c = 0; c < m_history.Done(); c++) //выполненные записи истории
+        {
+            const HistoryEntry& entry = m_history.At(c);
+            const string& name = m_keys[entry.m_key].GetName();
+            if (json) { os << (c > 0 ? ", " : "") << "{\"key\": " << JsonString(name) << ", \"count\": " << entry.m_count << "}"; }
+            else
+            {
+                os << "  " << name;
+                if (entry.m_count > 1) { os << " x" << entry.m_count; }
+                os << "\n";
+            }
+        }
+        os << (json ? "],\n \"latency_ns\": {" : "Latency, ns (count / mean / p50 / p99 / p999 / max):\n");
+        for (size_t p = 0; p < size_t(Probe::Count); p++)
+        {
+            ProbeSummary sum = m_metrics.Summary(Probe(p));
+            if (json)
+            {
+                os << (p > 0 ? ", " : "") << "\"" << ProbeName(Probe(p)) << "\": {\"count\": " << sum.count << ", \"mean\": " << sum.mean_ns
+                   << ", \"p50\": " << sum.p50_ns << ", \"p99\": " << sum.p99_ns << ", \"p999\": " << sum.p999_ns << ", \"max\": " << sum.max_ns << "}";
+            }
+            else
+            {
+                os << "  " << ProbeName(Probe(p)) << ": " << sum.count << " / " << sum.mean_ns << " / " << sum.p50_ns << " / "
+                   << sum.p99_ns << " / " << sum.p999_ns << " / " << sum.max_ns << "\n";
+            }
+        }
+        os << (json ? "},\n \"keys\": {" : "Key activations:\n");
+        bool first = true;
+        for (size_t k = 0; k < m_keys.size(); k++)
+        {
+            uint64_t presses = m_metrics.KeyPresses(KeyId(k));
+            if (presses == 0) { continue; }
+            if (json) { os << (first ? "" : ", ") << JsonString(m_keys[k].GetName() + "#" + to_string(k)) << ": " << presses; }
+            else { os << "  " << m_keys[k].GetName() << " (#" << k << "): " << presses << "\n"; }
+            first = false;
+        }
+        os << (json ? "},\n \"command_types\": {" : "Command type activations:\n");
+        first = true;
+        for (uint32_t t = 0; t < MetricsRegistry::TypeSlots; t++)
+        {
+            uint64_t count = m_metrics.TypeActivations(t);
+            if (count == 0) { continue; }
+            if (json) { os << (first ? "" : ", ") << "\"" << CommandHolder::TypeName(t) << "\": " << count; }
+            else { os << "  " << CommandHolder::TypeName(t) << ": " << count << "\n"; }
+            first = false;
+        }
+        os << (json ? "}}\n" : "") << flush;
+    }
+
+    void ActiveCommands() { Report(cout); } //вывод в консоль (текстовый отчет)
+};
+
+//команда клавиши, которая воспроизводит макрос
+class MacroCommand : public Command
+{
+private:
+    shared_ptr<const Macro> m_macro;
+    KeyBoard* m_board = nullptr;
+    ReplayMode m_mode = ReplayMode::Fast;
+    double m_scale = 1;
+
+public:
+    MacroCommand(KeyBoard& board, shared_ptr<const Macro> macro, ReplayMode mode = ReplayMode::Fast, double scale = 1)
+        : Command(), m_macro(move(macro)), m_board(&board), m_mode(mode), m_scale(scale)
+    {
+        m_name = "Macro";
+    }
+
+    void Activation() override { m_board->Play(m_macro, m_mode, m_scale); }
+    void Undo() override { cout << "Undo: " << m_name << " (nested presses are undone separately)" << endl; }
+};
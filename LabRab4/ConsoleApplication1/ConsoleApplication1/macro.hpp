@@ -0,0 +1,138 @@
+﻿#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include "registry.hpp"
+using namespace std;
+
+//записанная последовательность нажатий в компактном двоичном виде:
+//на событие - номер клавиши и (если запись с временем) пауза в микросекундах после
+//предыдущего события, оба числа в кодировке varint (обычно 2-4 байта на событие)
+class Macro
+{
+private:
+    vector<uint8_t> m_bytes;
+    size_t m_events = 0;
+    bool m_timed = true;
+    uint64_t m_duration = 0; //сумма пауз, мкс
+
+    void Put(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_bytes.push_back(uint8_t(value | 0x80));
+            value >>= 7;
+        }
+        m_bytes.push_back(uint8_t(value));
+    }
+
+    static uint64_t Get(const uint8_t* bytes, size_t size, size_t& pos)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= size) { throw runtime_error("Макрос поврежден: обрыв числа"); }
+            uint8_t byte = bytes[pos++];
+            value |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) { return value; }
+        }
+        throw runtime_error("Макрос поврежден: слишком длинное число");
+    }
+
+public:
+    explicit Macro(bool timed = true) : m_timed(timed) {}
+
+    //добавить событие; delay_us - пауза после предыдущего события (без времени не хранится)
+    void Append(KeyId key, uint64_t delay_us = 0)
+    {
+        Put(key);
+        if (m_timed)
+        {
+            Put(delay_us);
+            m_duration += delay_us;
+        }
+        m_events++;
+    }
+
+    //обход событий: f(номер клавиши, пауза в мкс); для записи без времени пауза - 0
+    template <typename F>
+    void ForEach(F f) const
+    {
+        size_t pos = 0;
+        while (pos < m_bytes.size())
+        {
+            KeyId key = KeyId(Get(m_bytes.data(), m_bytes.size(), pos));
+            uint64_t delay = m_timed ? Get(m_bytes.data(), m_bytes.size(), pos) : 0;
+            f(key, delay);
+        }
+    }
+
+    //одно событие с позиции pos (для пошагового воспроизведения); pos сдвигается
+    bool Next(size_t& pos, KeyId& key, uint64_t& delay_us) const
+    {
+        if (pos >= m_bytes.size()) { return false; }
+        key = KeyId(Get(m_bytes.data(), m_bytes.size(), pos));
+        delay_us = m_timed ? Get(m_bytes.data(), m_bytes.size(), pos) : 0;
+        return true;
+    }
+
+    size_t Events() const { return m_events; }
+    size_t Bytes() const { return m_bytes.size(); }
+    bool Timed() const { return m_timed; }
+    uint64_t DurationUs() const { return m_duration; }
+
+    //файл: "KMC1", флаг времени, число событий, длина данных, данные
+    void Save(const string& path) const
+    {
+        ofstream out(path, ios::binary);
+        if (!out) { throw runtime_error("Не удалось открыть файл " + path); }
+        uint64_t header[3] = { m_timed ? 1u : 0u, m_events, m_bytes.size() };
+        out.write("KMC1", 4);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(m_bytes.data()), streamsize(m_bytes.size()));
+        if (!out) { throw runtime_error("Ошибка записи макроса в " + path); }
+    }
+
+    static Macro Load(const string& path)
+    {
+        ifstream in(path, ios::binary);
+        if (!in) { throw runtime_error("Не удалось открыть файл " + path); }
+        char magic[4];
+        uint64_t header[3];
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!in || memcmp(magic, "KMC1", 4) != 0 || header[0] > 1) { throw runtime_error("Файл " + path + " не является макросом"); }
+        //заголовку не верим: длина данных сверяется с остатком файла до выделения памяти,
+        //число событий - с тем, что реально раскодировалось
+        streamoff data_start = in.tellg();
+        in.seekg(0, ios::end);
+        uint64_t remaining = uint64_t(in.tellg() - data_start);
+        in.seekg(data_start);
+        if (header[2] > remaining) { throw runtime_error("Макрос " + path + " обрезан"); }
+        if (header[2] < remaining) { throw runtime_error("Макрос " + path + " поврежден: лишние данные после событий"); }
+        Macro macro(header[0] != 0);
+        macro.m_bytes.resize(size_t(header[2]));
+        in.read(reinterpret_cast<char*>(macro.m_bytes.data()), streamsize(macro.m_bytes.size()));
+        if (!in) { throw runtime_error("Макрос " + path + " обрезан"); }
+        uint64_t events = 0;
+        macro.ForEach([&](KeyId, uint64_t delay)
+            {
+                events++;
+                macro.m_duration += delay;
+            });
+        if (events != header[1]) { throw runtime_error("Макрос " + path + " поврежден: число событий не совпадает с заголовком"); }
+        macro.m_events = size_t(events);
+        return macro;
+    }
+};
+
+//режим воспроизведения макроса
+enum class ReplayMode
+{
+    Fast,       //без пауз, пачками (повторы сливаются, как в PressBatch)
+    RealTime,   //с записанными паузами, через колесо таймеров
+    Scaled      //паузы умножаются на коэффициент (0.5 - вдвое быстрее)
+};
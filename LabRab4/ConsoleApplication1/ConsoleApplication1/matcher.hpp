@@ -0,0 +1,109 @@
+﻿#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "registry.hpp"
+using namespace std;
+
+//автомат для сочетаний ("Ctrl+Shift+V") и последовательностей ("g, g").
+//имя привязки - последовательность сочетаний через запятую; сочетание - клавиши через '+',
+//порядок модификаторов не важен ("Shift+Ctrl+V" == "Ctrl+Shift+V"). Пробел - часть имени:
+//"EXP 1" - одна клавиша, а не последовательность "EXP", "1"
+//все привязки лежат в одном дереве префиксов; переход - один поиск в хеш-таблице по паре
+//(состояние, сочетание). Новая привязка просто достраивает свою ветку
+class SequenceMatcher
+{
+public:
+    using State = uint32_t;
+    static constexpr State Root = 0;
+
+private:
+    struct Node
+    {
+        vector<KeyId> m_keys;       //привязки, которые заканчиваются здесь
+        uint32_t m_children = 0;    //сколько переходов ведет дальше
+    };
+
+    unordered_map<string, uint32_t, NameHash, equal_to<>> m_symbols; //сочетание -> номер
+    unordered_map<uint64_t, State> m_next;                           //(состояние, номер сочетания) -> состояние
+    vector<Node> m_nodes{ Node{} };
+
+    static uint64_t Edge(State state, uint32_t symbol) { return (uint64_t(state) << 32) | symbol; }
+
+    //номер сочетания; для неизвестного - false
+    bool Symbol(string_view chord, uint32_t& symbol) const
+    {
+        auto it = chord.find('+') == string_view::npos ? m_symbols.find(chord) : m_symbols.find(Normalize(chord));
+        if (it == m_symbols.end()) { return false; }
+        symbol = it->second;
+        return true;
+    }
+
+public:
+    //каноническая запись сочетания: модификаторы по алфавиту, основная клавиша последней
+    static string Normalize(string_view chord)
+    {
+        vector<string_view> parts;
+        size_t start = 0;
+        for (size_t pos; (pos = chord.find('+', start)) != string_view::npos; start = pos + 1)
+        {
+            parts.push_back(chord.substr(start, pos - start));
+        }
+        parts.push_back(chord.substr(start));
+        sort(parts.begin(), parts.end() - 1);
+        string result;
+        for (size_t n = 0; n < parts.size(); n++)
+        {
+            if (n > 0) { result.push_back('+'); }
+            result.append(parts[n]);
+        }
+        return result;
+    }
+
+    //добавить привязку (инкрементально: только ее ветка)
+    void Add(string_view binding, KeyId id)
+    {
+        State state = Root;
+        size_t start = 0;
+        while (start <= binding.size())
+        {
+            size_t pos = binding.find(',', start);
+            if (pos == string_view::npos) { pos = binding.size(); }
+            string_view chord = binding.substr(start, pos - start);
+            start = pos + 1;
+            while (!chord.empty() && chord.front() == ' ') { chord.remove_prefix(1); } //пробелы вокруг запятой
+            while (!chord.empty() && chord.back() == ' ') { chord.remove_suffix(1); }
+            if (chord.empty()) { continue; }
+            string name = Normalize(chord);
+            auto symbol = m_symbols.emplace(name, uint32_t(m_symbols.size())).first->second;
+            auto edge = m_next.find(Edge(state, symbol));
+            if (edge == m_next.end())
+            {
+                State created = State(m_nodes.size());
+                m_nodes.push_back(Node{});
+                m_nodes[state].m_children++;
+                edge = m_next.emplace(Edge(state, symbol), created).first;
+            }
+            state = edge->second;
+        }
+        if (state != Root) { m_nodes[state].m_keys.push_back(id); }
+    }
+
+    //переход по сочетанию; false, если из state по нему идти некуда
+    bool Step(State state, string_view chord, State& next) const
+    {
+        uint32_t symbol;
+        if (!Symbol(chord, symbol)) { return false; }
+        auto edge = m_next.find(Edge(state, symbol));
+        if (edge == m_next.end()) { return false; }
+        next = edge->second;
+        return true;
+    }
+
+    const vector<KeyId>& Keys(State state) const { return m_nodes[state].m_keys; }
+    bool HasChildren(State state) const { return m_nodes[state].m_children > 0; }
+    size_t States() const { return m_nodes.size(); }
+};
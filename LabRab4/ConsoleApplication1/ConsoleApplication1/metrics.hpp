@@ -0,0 +1,295 @@
+﻿#pragma once
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include "registry.hpp"
+using namespace std;
+
+//точки замера при выдаче нажатий
+enum class Probe
+{
+    PressKey,   //PressKey целиком
+    Lookup,     //поиск клавиш по имени
+    Activation, //выполнение команды (Key::Press)
+    Logging,    //история и журнал
+    KeyUndo,    //отмена команды (Key::KeyUndo)
+    Undo,       //KeyBoard::Undo целиком
+    Count
+};
+
+inline const char* ProbeName(Probe probe)
+{
+    static const char* names[] = { "PressKey", "Lookup", "Activation", "Logging", "KeyUndo", "Undo" };
+    return names[size_t(probe)];
+}
+
+//сводка по одной точке замера
+struct ProbeSummary
+{
+    uint64_t count = 0;
+    double mean_ns = 0;
+    uint64_t p50_ns = 0, p99_ns = 0, p999_ns = 0, max_ns = 0;
+};
+
+//гистограмма задержек в духе HDR: до 32 нс - точные значения, дальше на каждую степень
+//двойки 16 ячеек (погрешность до ~6%). Пишет один поток, читать можно из любого
+class LatencyHistogram
+{
+public:
+    static constexpr size_t Buckets = 976;
+
+private:
+    array<atomic<uint64_t>, Buckets> m_counts{};
+    atomic<uint64_t> m_total{ 0 };
+    atomic<uint64_t> m_sum{ 0 };
+    atomic<uint64_t> m_max{ 0 };
+
+    //единственный писатель: обычное сложение вместо атомарного read-modify-write
+    static void Bump(atomic<uint64_t>& counter, uint64_t by)
+    {
+        counter.store(counter.load(memory_order_relaxed) + by, memory_order_relaxed);
+    }
+
+public:
+    static size_t BucketOf(uint64_t ns)
+    {
+        if (ns < 32) { return size_t(ns); }
+        unsigned msb = unsigned(bit_width(ns)) - 1;
+        unsigned shift = msb - 4;
+        return size_t(msb - 4) * 16 + size_t(ns >> shift);
+    }
+
+    //нижняя граница ячейки
+    static uint64_t ValueOf(size_t bucket)
+    {
+        if (bucket < 32) { return bucket; }
+        size_t msb = bucket / 16 + 3;
+        uint64_t mantissa = bucket % 16 + 16;
+        return mantissa << (msb - 4);
+    }
+
+    void Record(uint64_t ns)
+    {
+        Bump(m_counts[BucketOf(ns)], 1);
+        Bump(m_total, 1);
+        Bump(m_sum, ns);
+        if (ns > m_max.load(memory_order_relaxed)) { m_max.store(ns, memory_order_relaxed); }
+    }
+
+    //сложить в сводную гистограмму (сводная не атомарная - ее собирает один читатель)
+    void AddTo(vector<uint64_t>& counts, uint64_t& total, uint64_t& sum, uint64_t& max_ns) const
+    {
+        for (size_t n = 0; n < Buckets; n++) { counts[n] += m_counts[n].load(memory_order_relaxed); }
+        total += m_total.load(memory_order_relaxed);
+        sum += m_sum.load(memory_order_relaxed);
+        max_ns = max(max_ns, m_max.load(memory_order_relaxed));
+    }
+
+    //сводка по сложенным гистограммам (см. AddTo)
+    static ProbeSummary Summarize(const vector<uint64_t>& counts, uint64_t total, uint64_t sum, uint64_t max_ns)
+    {
+        ProbeSummary summary;
+        summary.count = total;
+        summary.max_ns = max_ns;
+        if (total == 0) { return summary; }
+        summary.mean_ns = double(sum) / double(total);
+        auto percentile = [&](double q)
+        {
+            uint64_t rank = uint64_t(q * double(total - 1)) + 1, seen = 0;
+            for (size_t n = 0; n < counts.size(); n++)
+            {
+                seen += counts[n];
+                if (seen >= rank) { return min(ValueOf(n), max_ns); }
+            }
+            return max_ns;
+        };
+        summary.p50_ns = percentile(0.5);
+        summary.p99_ns = percentile(0.99);
+        summary.p999_ns = percentile(0.999);
+        return summary;
+    }
+
+    ProbeSummary Summary() const
+    {
+        vector<uint64_t> counts(Buckets);
+        uint64_t total = 0, sum = 0, max_ns = 0;
+        AddTo(counts, total, sum, max_ns);
+        return Summarize(counts, total, sum, max_ns);
+    }
+};
+
+//счетчики и гистограммы клавиатуры. Каждый поток пишет в свой блок (без блокировок и без
+//общих строк кэша), Summary складывает блоки всех потоков. Мьютекс берется только
+//при первом обращении потока и при чтении сводки
+class MetricsRegistry
+{
+public:
+    static constexpr size_t TypeSlots = 8;      //типов команд (CommandHolder::TypeIndex)
+    static constexpr size_t KeyChunk = 4096;    //счетчики клавиш выделяются кусками
+    static constexpr size_t KeyChunks = 1024;   //до 4M клавиш
+
+private:
+    struct ThreadBlock
+    {
+        array<LatencyHistogram, size_t(Probe::Count)> m_probes;
+        array<atomic<uint64_t>, TypeSlots> m_types{};
+        array<atomic<atomic<uint64_t>*>, KeyChunks> m_keys{};
+        uint32_t m_tick = 0; //счетчик для выборки замеров времени (только свой поток)
+
+        ~ThreadBlock()
+        {
+            for (auto& chunk : m_keys) { delete[] chunk.load(memory_order_relaxed); }
+        }
+    };
+
+    uint64_t m_id;                  //уникальный номер (адрес может достаться новому реестру)
+    mutex m_mutex;
+    vector<unique_ptr<ThreadBlock>> m_blocks;
+    atomic<bool> m_enabled{ true };
+    atomic<uint32_t> m_sample_mask{ 15 }; //время снимается у каждого 16-го события
+
+    static uint64_t NextId()
+    {
+        static atomic<uint64_t> next{ 1 };
+        return next.fetch_add(1, memory_order_relaxed);
+    }
+
+    ThreadBlock& Local()
+    {
+        thread_local uint64_t cached_id = 0;
+        thread_local ThreadBlock* cached_block = nullptr;
+        if (cached_id == m_id) { return *cached_block; }
+        thread_local unordered_map<uint64_t, ThreadBlock*> blocks; //на случай нескольких клавиатур
+        ThreadBlock*& block = blocks[m_id];
+        if (block == nullptr)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_blocks.push_back(make_unique<ThreadBlock>());
+            block = m_blocks.back().get();
+        }
+        cached_id = m_id;
+        cached_block = block;
+        return *block;
+    }
+
+    static void Bump(atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+public:
+    MetricsRegistry() : m_id(NextId()) {}
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    bool Enabled() const { return m_enabled.load(memory_order_relaxed); }
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, memory_order_relaxed); }
+
+    //время снимается не у каждого события, а у каждого n-го (n - степень двойки; 1 - у всех):
+    //чтение часов стоит десятки наносекунд, а распределение задержек выборка сохраняет
+    void SetSampleEvery(uint32_t n)
+    {
+        if (n == 0 || (n & (n - 1)) != 0) { throw invalid_argument("Шаг выборки должен быть степенью двойки"); }
+        m_sample_mask.store(n - 1, memory_order_relaxed);
+    }
+
+    //начало замера: текущее время, если событие попало в выборку, иначе 0
+    int64_t Start()
+    {
+        if (!Enabled()) { return 0; }
+        ThreadBlock& block = Local();
+        if ((block.m_tick++ & m_sample_mask.load(memory_order_relaxed)) != 0) { return 0; }
+        return Now();
+    }
+
+    static int64_t Now() { return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    void Record(Probe probe, int64_t start_ns, int64_t end_ns)
+    {
+        Local().m_probes[size_t(probe)].Record(uint64_t(max<int64_t>(0, end_ns - start_ns)));
+    }
+
+    //срабатывание клавиши и типа ее команды
+    void CountKey(KeyId id, uint32_t type)
+    {
+        ThreadBlock& block = Local();
+        Bump(block.m_types[min<size_t>(type, TypeSlots - 1)]);
+        size_t chunk = id / KeyChunk;
+        if (chunk >= KeyChunks) { return; }
+        atomic<uint64_t>* counters = block.m_keys[chunk].load(memory_order_acquire);
+        if (counters == nullptr)
+        {
+            counters = new atomic<uint64_t>[KeyChunk]{};
+            block.m_keys[chunk].store(counters, memory_order_release);
+        }
+        Bump(counters[id % KeyChunk]);
+    }
+
+    ProbeSummary Summary(Probe probe)
+    {
+        vector<uint64_t> counts(LatencyHistogram::Buckets);
+        uint64_t total = 0, sum = 0, max_ns = 0;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            for (const auto& block : m_blocks) { block->m_probes[size_t(probe)].AddTo(counts, total, sum, max_ns); }
+        }
+        return LatencyHistogram::Summarize(counts, total, sum, max_ns);
+    }
+
+    uint64_t KeyPresses(KeyId id)
+    {
+        size_t chunk = id / KeyChunk;
+        if (chunk >= KeyChunks) { return 0; }
+        uint64_t total = 0;
+        lock_guard<mutex> lock(m_mutex);
+        for (const auto& block : m_blocks)
+        {
+            const atomic<uint64_t>* counters = block->m_keys[chunk].load(memory_order_acquire);
+            if (counters != nullptr) { total += counters[id % KeyChunk].load(memory_order_relaxed); }
+        }
+        return total;
+    }
+
+    uint64_t TypeActivations(uint32_t type)
+    {
+        uint64_t total = 0;
+        lock_guard<mutex> lock(m_mutex);
+        for (const auto& block : m_blocks) { total += block->m_types[min<size_t>(type, TypeSlots - 1)].load(memory_order_relaxed); }
+        return total;
+    }
+};
+
+//строка для JSON в кавычках
+inline string JsonString(string_view text)
+{
+    string out = "\"";
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                const char* hex = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[(c >> 4) & 0xF];
+                out += hex[c & 0xF];
+            }
+            else { out += c; }
+        }
+    }
+    return out + "\"";
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+using namespace std;
+
+using KeyId = uint32_t; //номер клавиши = ее позиция в KeyBoard
+
+//хеш, который принимает и string, и string_view: поиск по string_view не создает строку
+struct NameHash
+{
+    using is_transparent = void;
+    size_t operator()(string_view name) const { return hash<string_view>{}(name); }
+};
+
+//индекс клавиш по имени: имя хранится один раз, к нему - все клавиши с этим именем
+class KeyRegistry
+{
+private:
+    unordered_map<string, vector<KeyId>, NameHash, equal_to<>> m_index;
+
+public:
+    void Add(string_view name, KeyId id)
+    {
+        auto it = m_index.find(name);
+        if (it == m_index.end()) { it = m_index.emplace(string(name), vector<KeyId>{}).first; }
+        it->second.push_back(id);
+    }
+
+    //все клавиши с таким именем в порядке добавления; nullptr, если таких нет
+    const vector<KeyId>* Find(string_view name) const
+    {
+        auto it = m_index.find(name);
+        return it == m_index.end() ? nullptr : &it->second;
+    }
+
+    size_t Names() const { return m_index.size(); }
+};
@@ -0,0 +1,165 @@
+﻿#pragma once
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <exception>
+#include <cstdint>
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+//колесо таймеров: отложенные задачи раскладываются по ячейкам (одна ячейка = один тик),
+//постановка и отмена - O(1), а Advance() выполняет только то, что уже пора.
+//никто не спит: колесо прокручивает тот, кто вызывает Advance (например, KeyBoard::Poll)
+class TimerWheel
+{
+public:
+    using TimerId = uint64_t;
+
+private:
+    struct Entry
+    {
+        TimerId id;
+        uint64_t tick;          //тик, на котором задача должна выполниться
+        function<void()> task;
+    };
+
+    chrono::microseconds m_tick;        //длительность одного тика
+    vector<vector<Entry>> m_slots;      //ячейки колеса
+    Clock::time_point m_start;          //момент нулевого тика
+    uint64_t m_current = 0;             //последний обработанный тик
+    TimerId m_next_id = 1;
+    unordered_map<TimerId, size_t> m_where; //номер таймера -> ячейка (для отмены)
+    static constexpr size_t InBatch = size_t(-1); //вместо ячейки: задача уже в пачке Advance, но еще не выполнена
+
+    uint64_t TickOf(Clock::time_point t) const
+    {
+        if (t <= m_start) { return 0; }
+        return uint64_t((t - m_start) / m_tick);
+    }
+
+    //забираем из ячейки задачи, которым уже пора (остальные ждут следующих оборотов)
+    void Collect(size_t slot, uint64_t upto, vector<Entry>& due)
+    {
+        vector<Entry>& entries = m_slots[slot];
+        for (size_t n = 0; n < entries.size();)
+        {
+            if (entries[n].tick <= upto)
+            {
+                m_where[entries[n].id] = InBatch; //отмена до выполнения по-прежнему возможна
+                due.push_back(move(entries[n]));
+                entries[n] = move(entries.back());
+                entries.pop_back();
+            }
+            else { n++; }
+        }
+    }
+
+public:
+    explicit TimerWheel(chrono::microseconds tick = chrono::milliseconds(1), size_t slots = 512)
+        : m_tick(tick), m_slots(slots), m_start(Clock::now()) {}
+
+    //поставить задачу через delay от текущего момента; выполнится не раньше следующего тика
+    TimerId Schedule(chrono::microseconds delay, function<void()> task)
+    {
+        uint64_t tick = TickOf(Clock::now() + delay + m_tick - chrono::microseconds(1)); //округление вверх
+        tick = max(tick, m_current + 1);
+        size_t slot = size_t(tick % m_slots.size());
+        TimerId id = m_next_id++;
+        m_slots[slot].push_back(Entry{ id, tick, move(task) });
+        m_where[id] = slot;
+        return id;
+    }
+
+    //отмена; false, если задача уже выполнилась или ее не было.
+    //задачу, уже забранную в пачку Advance (ее отменяет задача, выполненная раньше в той же пачке), Advance пропустит
+    bool Cancel(TimerId id)
+    {
+        auto it = m_where.find(id);
+        if (it == m_where.end()) { return false; }
+        if (it->second == InBatch)
+        {
+            m_where.erase(it);
+            return true;
+        }
+        vector<Entry>& entries = m_slots[it->second];
+        for (size_t n = 0; n < entries.size(); n++)
+        {
+            if (entries[n].id == id)
+            {
+                entries[n] = move(entries.back());
+                entries.pop_back();
+                break;
+            }
+        }
+        m_where.erase(it);
+        return true;
+    }
+
+    //выполнить все задачи со сроком до now; возвращает число выполненных
+    size_t Advance(Clock::time_point now = Clock::now())
+    {
+        uint64_t target = TickOf(now);
+        if (target <= m_current) { return 0; }
+        vector<Entry> due;
+        if (target - m_current >= m_slots.size()) //прошло больше оборота - смотрим все ячейки один раз
+        {
+            for (size_t slot = 0; slot < m_slots.size(); slot++) { Collect(slot, target, due); }
+        }
+        else
+        {
+            for (uint64_t t = m_current + 1; t <= target; t++) { Collect(size_t(t % m_slots.size()), target, due); }
+        }
+        m_current = target;
+        //порядок выполнения - по сроку, при равенстве - по порядку постановки
+        sort(due.begin(), due.end(), [](const Entry& a, const Entry& b) { return a.tick != b.tick ? a.tick < b.tick : a.id < b.id; });
+        //задача может ставить новые задачи. Исключение одной задачи не отменяет остальные
+        //из пачки (они уже сняты с колеса): выполняем все, первое исключение - после цикла
+        exception_ptr error;
+        size_t done = 0;
+        for (Entry& entry : due)
+        {
+            auto it = m_where.find(entry.id);
+            if (it == m_where.end()) { continue; } //отменена, пока ждала своей очереди в пачке
+            m_where.erase(it);
+            done++;
+            try { entry.task(); }
+            catch (...) { if (!error) { error = current_exception(); } }
+        }
+        if (error) { rethrow_exception(error); }
+        return done;
+    }
+
+    size_t Pending() const { return m_where.size(); }
+
+    //момент, к которому стоит вызвать Advance еще раз (если задач нет - через оборот колеса)
+    Clock::time_point NextDeadline() const
+    {
+        uint64_t best = m_current + m_slots.size();
+        for (const auto& entries : m_slots)
+        {
+            for (const Entry& entry : entries) { best = min(best, entry.tick); }
+        }
+        return m_start + m_tick * best;
+    }
+};
+
+//политика выдачи команд клавиши
+struct DispatchPolicy
+{
+    enum class Kind
+    {
+        Immediate,  //команда выполняется сразу в PressKey
+        Debounce,   //выполняется один раз, когда нажатия затихли на interval
+        Pace        //не чаще раза в interval; лишние нажатия откладываются в очередь на колесе
+    };
+
+    Kind kind = Kind::Immediate;
+    chrono::microseconds interval{ 0 };
+
+    static DispatchPolicy Immediate() { return {}; }
+    static DispatchPolicy Debounce(chrono::microseconds quiet) { return { Kind::Debounce, quiet }; }
+    static DispatchPolicy Pace(chrono::microseconds period) { return { Kind::Pace, period }; }
+};